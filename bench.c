@@ -0,0 +1,339 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <gsl/gsl_odeiv2.h>
+
+#include "par.h"
+#include "sol.h"
+#include "hw.h"
+#include "pen.h"
+#include "gl_geometries.h"
+
+#define BENCH_WARMUP 3 // samples discarded
+#define BENCH_SAMPLES 25 // samples summarised
+#define BENCH_TOLERANCE 0.15 // relative slowdown of the median reported as regression
+#define BENCH_MOCK "/tmp/pen-bench.gpio"
+
+/*
+ * microbenchmarks of the hot functions
+ *
+ * every benchmark runs a fixed number of iterations per sample, after a
+ * few warm-up samples the time per iteration is summarised over the
+ * samples (min, median, mean, standard deviation) and written as json to
+ * stdout, with a baseline (json of an earlier run) the medians are compared
+ * and the exit status is 1 if one got slower than the tolerance
+ *
+ * the kernels are those selected for the cpu, -g keeps the generic ones
+ *
+ * run from the source directory (configs/), see "make bench"
+ */
+
+static pendulum_configuration conf;
+static geometry_data geometry;
+static volatile double sink;
+
+/* the modules report through the console user interface, not linked here */
+void ui_print (const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	vfprintf(stderr, format, arguments);
+	va_end(arguments);
+}
+
+/* model */
+
+static void load (const char* configname) {
+	if ( par_load_configuration(configname, &conf, PAR_NOT_RESET) ) {
+		fprintf(stderr, "configuration %s failed!\n\r", configname);
+		exit(2);
+	}
+}
+
+static void setup_model () {
+	load("conf-default");
+}
+
+static void run_rhs (unsigned int n) {
+	double y[2] = { 1.0, 0.5 }, dydt[2];
+	while ( n-- ) {
+		sol_kernels->rhs(0.0, y, dydt, &conf);
+		y[1] += 1.0e-9 * dydt[1];
+	}
+	sink = y[1];
+}
+
+static void run_rhs_linear (unsigned int n) {
+	double y[2] = { 1.0, 0.5 }, dydt[2];
+	while ( n-- ) {
+		sol_kernels->rhs_linear(0.0, y, dydt, &conf);
+		y[1] += 1.0e-9 * dydt[1];
+	}
+	sink = y[1];
+}
+
+static void run_jac (unsigned int n) {
+	double y[2] = { 1.0, 0.5 }, dfdy[4], dfdt[2];
+	while ( n-- ) {
+		sol_kernels->jac(0.0, y, dfdy, dfdt, &conf);
+		y[0] += 1.0e-9 * dfdy[2];
+	}
+	sink = y[0];
+}
+
+/* one frame (1/60 s) of the solver per stepper, from the initial condition of each sample */
+
+static void setup_frame (const char* configname, const char* stepper) {
+
+	load(configname);
+	if ( strcmp(stepper, "rkf45") == 0 )
+		conf.solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_rkf45;
+	else if ( strcmp(stepper, "rk8pd") == 0 )
+		conf.solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_rk8pd;
+	else if ( strcmp(stepper, "adams") == 0 )
+		conf.solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_msadams;
+	else if ( strcmp(stepper, "verlet") == 0 )
+		conf.solver.symplectic = 2;
+	else if ( strcmp(stepper, "yoshida4") == 0 )
+		conf.solver.symplectic = 4;
+	else if ( strcmp(stepper, "yoshida6") == 0 )
+		conf.solver.symplectic = 6;
+	else
+		conf.solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_rk4;
+
+	conf.temp.angle = conf.model.initial_angle;
+	if ( sol_solver_init(&conf) ) {
+		fprintf(stderr, "solver initialization failed (%s, %s)!\n\r", configname, stepper);
+		exit(2);
+	}
+}
+
+static void setup_rk4 () { setup_frame("conf-default", "rk4"); }
+static void setup_rkf45 () { setup_frame("conf-default", "rkf45"); }
+static void setup_rk8pd () { setup_frame("conf-default", "rk8pd"); }
+static void setup_adams () { setup_frame("conf-default", "adams"); }
+static void setup_verlet () { setup_frame("conf-earth-undamped", "verlet"); }
+static void setup_yoshida4 () { setup_frame("conf-earth-undamped", "yoshida4"); }
+static void setup_yoshida6 () { setup_frame("conf-earth-undamped", "yoshida6"); }
+
+static void run_frame (unsigned int n) {
+	while ( n-- ) {
+		sol_set_time_next_frame(conf.temp.time + 1.0 / 60.0);
+		sol_solve_next_frame(&conf);
+	}
+	sink = conf.temp.angle;
+}
+
+/* configuration */
+
+static void run_par_load (unsigned int n) {
+	while ( n-- )
+		load("conf-default");
+	sink = conf.temp.moment_of_inertia;
+}
+
+/* geometry */
+
+static void run_geometry_generate (unsigned int n) {
+	while ( n-- ) {
+		GeneratePendulumGeometry(&geometry);
+		GeometryFree(&geometry);
+	}
+}
+
+static void setup_geometry () {
+	static int ready = 0;
+	if ( !ready )
+		GeneratePendulumGeometry(&geometry);
+	ready = 1;
+}
+
+static void run_geometry_update (unsigned int n) {
+	while ( n-- )
+		GeometryUpdatePendulum(&geometry, 0.5f + (n & 1) * 0.01f);
+	sink = geometry.vertices[0];
+}
+
+/* magnet gpio, mock file */
+
+static void setup_gpio () {
+	static int ready = 0;
+	if ( !ready && hw_init(HW_GPIO_MOCK, BENCH_MOCK, HW_GPIO_LINE) ) {
+		fprintf(stderr, "mock gpio failed!\n\r");
+		exit(2);
+	}
+	ready = 1;
+}
+
+static void run_gpio (unsigned int n) {
+	while ( n-- ) {
+		if ( n & 1 )
+			hw_magnet_acquire();
+		else
+			hw_magnet_release(NULL);
+	}
+}
+
+typedef struct {
+	const char* name;
+	unsigned int iterations; // per sample
+	void (*setup) (); // before every sample, not timed
+	void (*run) (unsigned int n);
+} benchmark;
+
+static const benchmark benchmarks[] = {
+	{ "rhs", 100000, setup_model, run_rhs },
+	{ "rhs_linear", 100000, setup_model, run_rhs_linear },
+	{ "jac", 100000, setup_model, run_jac },
+	{ "frame_rk4", 60, setup_rk4, run_frame },
+	{ "frame_rkf45", 60, setup_rkf45, run_frame },
+	{ "frame_rk8pd", 60, setup_rk8pd, run_frame },
+	{ "frame_adams", 60, setup_adams, run_frame },
+	{ "frame_verlet", 60, setup_verlet, run_frame },
+	{ "frame_yoshida4", 60, setup_yoshida4, run_frame },
+	{ "frame_yoshida6", 60, setup_yoshida6, run_frame },
+	{ "par_load_configuration", 20, NULL, run_par_load },
+	{ "GeneratePendulumGeometry", 1000, NULL, run_geometry_generate },
+	{ "GeometryUpdatePendulum", 1000, setup_geometry, run_geometry_update },
+	{ "gpio_write_mock", 1000, setup_gpio, run_gpio },
+};
+
+typedef struct {
+	double min, median, mean, stddev; // ns per iteration
+} summary;
+
+static int compare (const void* a, const void* b) {
+	const double x = *(const double*) a, y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static void measure (const benchmark* bench, summary* result) {
+
+	double samples[BENCH_SAMPLES];
+	struct timespec start, end;
+	unsigned int i;
+
+	for ( i = 0; i < BENCH_WARMUP + BENCH_SAMPLES; i++ ) {
+		if ( bench->setup != NULL )
+			bench->setup();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		bench->run(bench->iterations);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if ( i >= BENCH_WARMUP )
+			samples[i - BENCH_WARMUP] = ((end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec))
+				/ bench->iterations;
+	}
+
+	qsort(samples, BENCH_SAMPLES, sizeof(double), compare);
+	result->min = samples[0];
+	result->median = samples[BENCH_SAMPLES / 2];
+
+	double sum = 0.0, square = 0.0;
+	for ( i = 0; i < BENCH_SAMPLES; i++ )
+		sum += samples[i];
+	result->mean = sum / BENCH_SAMPLES;
+	for ( i = 0; i < BENCH_SAMPLES; i++ )
+		square += (samples[i] - result->mean) * (samples[i] - result->mean);
+	result->stddev = sqrt(square / (BENCH_SAMPLES - 1));
+}
+
+/* median of a benchmark in a baseline written by this program, < 0 if missing */
+static double baseline_median (FILE* file, const char* name) {
+
+	char line[512], found[128];
+	double median;
+
+	rewind(file);
+	while ( fgets(line, sizeof(line), file) != NULL ) {
+		const char* field = strstr(line, "\"median_ns\": ");
+		if ( sscanf(line, " { \"name\": \"%127[^\"]\"", found) == 1 && strcmp(found, name) == 0 &&
+				field != NULL && sscanf(field, "\"median_ns\": %lf", &median) == 1 )
+			return median;
+	}
+	return -1.0;
+}
+
+int main (int argc, char *argv[]) {
+
+	const char* baseline = NULL;
+	double tolerance = BENCH_TOLERANCE;
+	int generic = 0;
+
+	int option;
+	while ( (option = getopt(argc, argv, "b:t:gh")) != -1 ) {
+		switch ( option ) {
+			case 'b':
+				baseline = optarg;
+				break;
+			case 't':
+				tolerance = atof(optarg);
+				break;
+			case 'g':
+				generic = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-g] [-b baseline.json [-t tolerance]] > result.json\n", argv[0]);
+				return 2;
+		}
+	}
+
+	FILE* file = NULL;
+	if ( baseline != NULL && (file = fopen(baseline, "r")) == NULL )
+		fprintf(stderr, "no baseline %s, nothing compared\n\r", baseline);
+
+	const unsigned int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+	unsigned int i, regressions = 0;
+
+	const char* variant = generic ? sol_kernels->name : sol_kernels_select();
+
+	printf("{\n\t\"kernels\": \"%s\",\n\t\"samples\": %u,\n\t\"warmup\": %u,\n\t\"benchmarks\": [\n",
+		variant, BENCH_SAMPLES, BENCH_WARMUP);
+	for ( i = 0; i < count; i++ ) {
+		summary result;
+		measure(&benchmarks[i], &result);
+		printf("\t\t{ \"name\": \"%s\", \"iterations\": %u, \"min_ns\": %.1f, \"median_ns\": %.1f, \"mean_ns\": %.1f, \"stddev_ns\": %.1f }%s\n",
+			benchmarks[i].name, benchmarks[i].iterations, result.min, result.median, result.mean, result.stddev,
+			i + 1 < count ? "," : "");
+		fflush(stdout);
+
+		if ( file == NULL )
+			continue;
+		const double reference = baseline_median(file, benchmarks[i].name);
+		if ( reference > 0.0 && result.median > reference * (1.0 + tolerance) ) {
+			fprintf(stderr, "regression: %s %.1f ns, baseline %.1f ns (+%.0f%%)\n\r", benchmarks[i].name,
+				result.median, reference, 100.0 * (result.median / reference - 1.0));
+			regressions++;
+		}
+	}
+	printf("\t]\n}\n");
+
+	if ( file != NULL )
+		fclose(file);
+	GeometryFree(&geometry);
+	hw_terminate();
+	sol_solver_free(&conf);
+	unlink(BENCH_MOCK);
+
+	return regressions ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <gsl/gsl_fit.h>
+
+#include "cal.h"
+#include "sol.h"
+#include "pen.h"
+
+#define CAL_CROSSINGS_MAX 256
+#define CAL_STEP 1.0e-3 // s, crossings are interpolated linearly between steps
+
+/*
+ * release delay calibration from a measured swing series
+ *
+ * the file lists the times (s, one per line, "#" starts a comment) at which
+ * the real ball passed the rest position, counted from switching off the
+ * magnet, beginning with the first pass (e.g. light barrier or video)
+ *
+ * the same passes are simulated from t = 0 and the measured times are fitted
+ * linearly against the simulated ones, t_measured = delay + slope * t_simulated,
+ * the intercept is the release delay, a slope different from one shows a
+ * period error of the model
+ */
+
+static int read_series (const char* filename, double* times, int max) {
+
+	FILE* file = fopen(filename, "r");
+	if ( file == NULL ) {
+		fprintf(stderr, "cannot open swing series \"%s\"!\n\r", filename);
+		return -1;
+	}
+
+	char line[256];
+	int count = 0;
+	while ( count < max && fgets(line, sizeof(line), file) != NULL ) {
+		if ( line[0] == '#' )
+			continue;
+		if ( sscanf(line, "%lf", &times[count]) == 1 )
+			count++;
+	}
+
+	fclose(file);
+	return count;
+}
+
+static int simulate_series (pendulum_configuration* conf, double* times, int count, double duration) {
+
+	conf->temp.angle = conf->model.initial_angle;
+	if ( sol_solver_init(conf) )
+		return -1;
+
+	int found = 0;
+	double angle = conf->temp.angle;
+	unsigned int n;
+	for ( n = 1; found < count && n * CAL_STEP <= duration && !simflag; n++ ) {
+		sol_set_time_next_frame(n * CAL_STEP);
+		sol_solve_next_frame(conf);
+		if ( (angle < 0.0) != (conf->temp.angle < 0.0) )
+			times[found++] = (n - 1 + angle / (angle - conf->temp.angle)) * CAL_STEP;
+		angle = conf->temp.angle;
+	}
+
+	sol_solver_terminate(conf);
+	return found;
+}
+
+int cal_release_delay (pendulum_configuration* conf, const char* filename) {
+
+	double measured[CAL_CROSSINGS_MAX], simulated[CAL_CROSSINGS_MAX];
+
+	const int count = read_series(filename, measured, CAL_CROSSINGS_MAX);
+	if ( count < 3 ) {
+		fprintf(stderr, "at least three passes needed for calibration!\n\r");
+		return -1;
+	}
+
+	const int found = simulate_series(conf, simulated, count, measured[count-1] + 1.0);
+	if ( found != count ) {
+		fprintf(stderr, "simulation has %d of %d passes, check model and series!\n\r", found < 0 ? 0 : found, count);
+		return -1;
+	}
+
+	double delay, slope, cov00, cov01, cov11, sumsq;
+	gsl_fit_linear(simulated, 1, measured, 1, count, &delay, &slope, &cov00, &cov01, &cov11, &sumsq);
+
+	printf("passes: %d, residual: %.3f ms rms\r\n", count, sqrt(sumsq / count) * 1.0e3);
+	printf("period ratio (measured/simulated): %.5f\r\n", slope);
+	printf("release delay: %.2f ms (+- %.2f ms)\r\n", delay * 1.0e3, sqrt(cov00) * 1.0e3);
+	printf("add to the <hardware> section of the configuration:\r\n");
+	printf("\t<release_delay unit=\"s\">%.4f</release_delay>\r\n", delay);
+
+	conf->hardware.release_delay = delay;
+
+	return 0;
+}
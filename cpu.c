@@ -0,0 +1,57 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if defined(__arm__)
+#include <sys/auxv.h>
+#endif
+
+#include "cpu.h"
+
+/* linux hwcap bits of 32 bit arm (asm/hwcap.h) */
+#define CPU_HWCAP_VFP	(1 << 6)
+#define CPU_HWCAP_NEON	(1 << 12)
+#define CPU_HWCAP_VFPv4	(1 << 16)
+
+/*
+ * the features the numeric kernels are built for (see sol_kernels_select),
+ * arm reports them in the auxiliary vector of the process, x86 through
+ * cpuid (gcc checks that the os saves the avx registers)
+ */
+unsigned int cpu_features () {
+
+	unsigned int features = 0;
+
+#if defined(__arm__)
+	const unsigned long hwcap = getauxval(AT_HWCAP);
+	if ( hwcap & CPU_HWCAP_VFP )
+		features |= CPU_VFP;
+	if ( (hwcap & CPU_HWCAP_NEON) && (hwcap & CPU_HWCAP_VFPv4) )
+		features |= CPU_NEON;
+#elif defined(__aarch64__)
+	// part of armv8-a
+	features |= CPU_VFP | CPU_NEON;
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports("sse4.2") )
+		features |= CPU_SSE4;
+	if ( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+		features |= CPU_AVX2;
+#endif
+
+	return features;
+}
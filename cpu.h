@@ -0,0 +1,29 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PEN_CPU
+#define PEN_CPU
+
+/* features of the running cpu, see cpu_features */
+#define CPU_VFP		(1 << 0)	// arm floating point (the pi 1 baseline)
+#define CPU_NEON	(1 << 1)	// arm advanced simd with vfpv4 (pi 2 and later)
+#define CPU_SSE4	(1 << 2)	// x86 sse 4.2
+#define CPU_AVX2	(1 << 3)	// x86 avx2 with fma
+
+unsigned int cpu_features ();
+
+#endif
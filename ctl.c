@@ -0,0 +1,536 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ctl.h"
+#include "pen.h"
+#include "ui.h"
+#include "gl.h"
+#include "sol.h"
+
+#define CTL_CLIENTS 4
+#define CTL_LINE 256
+#define CTL_JOBS 32 // queued and finished jobs kept for "result"
+#define CTL_JOB_DURATION_MAX 3600.0 // simulated s
+#define CTL_JOB_SAMPLES_MAX 1000000
+#define CTL_JOB_STEP 0.05 // simulated s per solver call at most
+#define CTL_JOB_SLICE 0.01 // s of work between two event waits
+
+/*
+ * local control socket with a line protocol, one command per line, every
+ * command is answered with one line starting with "ok" or "err":
+ *
+ *   status                          mode, time, angle, velocity, configuration
+ *   load <configuration>            (idle) load configs/<configuration>.xml
+ *   angle <rad>                     (idle, setup) initial angle
+ *   geometry <x> <y> <rodlength>    (idle, setup) suspension and virtual rod length
+ *   setup                           (idle) enter setup, like a configuration key
+ *   start                           (idle, setup) setup and release at once
+ *   stop                            (setup, sim) end setup or simulation,
+ *                                   (idle) cancel the running job
+ *   job <configuration> <duration> <rate> <file|->
+ *                                   queue a headless run, returns the job id,
+ *                                   at most CTL_JOB_DURATION_MAX s and
+ *                                   CTL_JOB_SAMPLES_MAX samples
+ *   result <id>                     state of a job: queued, running, done or failed
+ *   quit                            end the program
+ *
+ * jobs run one after another while the program is idle, they write
+ * "t angle velocity energy" at <rate> samples per second to <file>,
+ * a running job advances in slices of CTL_JOB_SLICE s between two event
+ * waits so signals, keys and commands are still served
+ */
+
+typedef enum {JOB_FREE, JOB_QUEUED, JOB_RUNNING, JOB_DONE, JOB_FAILED} CTL_JOB_T;
+
+typedef struct {
+	CTL_JOB_T status;
+	unsigned int id;
+	char configname[64];
+	double duration;
+	double rate;
+	char filename[128];
+	/* results */
+	unsigned int samples;
+	double time, angle, velocity, energy, initial_energy;
+} ctl_job;
+
+static int listen_fd = -1;
+static char socket_path[108];
+
+static struct {
+	int fd;
+	unsigned int length;
+	char line[CTL_LINE];
+} clients[CTL_CLIENTS];
+
+static ctl_job jobs[CTL_JOBS];
+static unsigned int job_next_id = 1;
+static int release_pending = 0;
+
+static pendulum_configuration job_conf;
+static pendulum_configuration load_conf;
+
+/* the running job, its output and progress */
+static ctl_job* job_active = NULL;
+static FILE* job_file = NULL;
+static unsigned int job_sample;
+static unsigned int job_samples;
+
+static const char* job_status_names[] = {"free", "queued", "running", "done", "failed"};
+static const char* mode_names[] = {"idle", "setup", "sim"};
+
+int ctl_init (const char* path) {
+
+	unsigned int i;
+	for ( i = 0; i < CTL_CLIENTS; i++ )
+		clients[i].fd = -1;
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if ( listen_fd == -1 ) {
+		perror("socket");
+		return -1;
+	}
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+	snprintf(socket_path, sizeof(socket_path), "%s", path);
+
+	unlink(path);
+	if ( bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) || listen(listen_fd, CTL_CLIENTS) ) {
+		perror("bind");
+		close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+
+	return ev_add(listen_fd, EV_CTL);
+}
+
+static void client_close (unsigned int index) {
+	ev_remove(clients[index].fd);
+	close(clients[index].fd);
+	clients[index].fd = -1;
+	clients[index].length = 0;
+}
+
+void ctl_terminate () {
+
+	unsigned int i;
+	for ( i = 0; i < CTL_CLIENTS; i++ )
+		if ( clients[i].fd != -1 )
+			client_close(i);
+
+	if ( listen_fd != -1 ) {
+		ev_remove(listen_fd);
+		close(listen_fd);
+		unlink(socket_path);
+	}
+	listen_fd = -1;
+
+	ctl_job_cancel();
+	sol_solver_free(&job_conf);
+}
+
+/* replies never block, a client that does not read loses them */
+static void reply (int fd, const char *format, ...) {
+
+	char message[CTL_LINE];
+	va_list arglist;
+	va_start(arglist, format);
+	int length = vsnprintf(message, sizeof(message) - 1, format, arglist);
+	va_end(arglist);
+
+	if ( length < 0 )
+		return;
+	if ( length > (int) sizeof(message) - 2 )
+		length = sizeof(message) - 2;
+	message[length++] = '\n';
+
+	send(fd, message, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+static ctl_job* job_find (unsigned int id) {
+
+	unsigned int i;
+	for ( i = 0; i < CTL_JOBS; i++ )
+		if ( jobs[i].status != JOB_FREE && jobs[i].id == id )
+			return &jobs[i];
+	return NULL;
+}
+
+/* a free slot or the oldest finished job */
+static ctl_job* job_slot () {
+
+	ctl_job* slot = NULL;
+	unsigned int i;
+	for ( i = 0; i < CTL_JOBS; i++ ) {
+		if ( jobs[i].status == JOB_FREE )
+			return &jobs[i];
+		if ( (jobs[i].status == JOB_DONE || jobs[i].status == JOB_FAILED) &&
+				(slot == NULL || jobs[i].id < slot->id) )
+			slot = &jobs[i];
+	}
+	return slot;
+}
+
+/* the parser falls back to conf-default, a missing file is an error for commands */
+static int configuration_exists (const char* name) {
+
+	char filename[128];
+	snprintf(filename, sizeof(filename), "configs/%s.xml", name);
+	return access(filename, R_OK) == 0;
+}
+
+static int command (int fd, char* line, pendulum_configuration* conf, int mode) {
+
+	char name[64], file[128];
+	double a, b, c;
+	unsigned int id;
+
+	if ( strcmp(line, "status") == 0 ) {
+		reply(fd, "ok %s %f %f %f %s", mode_names[mode], conf->temp.time,
+			conf->temp.angle, conf->temp.velocity, conf->temp.configname);
+
+	} else if ( sscanf(line, "load %63s", name) == 1 ) {
+		if ( mode != CTL_IDLE ) {
+			reply(fd, "err busy");
+			return UI_INPUT_KEY;
+		}
+		if ( !configuration_exists(name) ) {
+			reply(fd, "err no configuration %s", name);
+			return UI_INPUT_KEY;
+		}
+		// a failing parse stops halfway, keep conf untouched until it succeeded
+		load_conf = *conf;
+		if ( par_load_configuration(name, &load_conf, PAR_NOT_RESET) ) {
+			reply(fd, "err configuration not loaded");
+			return UI_INPUT_KEY;
+		}
+		*conf = load_conf;
+		// the systems have to point to the live configuration, not the copy
+		conf->model.equation.params = conf;
+		conf->model.base.params = conf;
+		reply(fd, "ok");
+
+	} else if ( sscanf(line, "angle %lf", &a) == 1 ) {
+		if ( mode == CTL_SIM ) {
+			reply(fd, "err busy");
+			return UI_INPUT_KEY;
+		}
+		conf->model.initial_angle = a;
+		conf->temp.angle = a;
+		reply(fd, "ok");
+		return UI_INPUT_REDRAW;
+
+	} else if ( sscanf(line, "geometry %lf %lf %lf", &a, &b, &c) == 3 ) {
+		if ( mode == CTL_SIM ) {
+			reply(fd, "err busy");
+			return UI_INPUT_KEY;
+		}
+		// during setup the geometry is redrawn at once, otherwise the next setup applies it
+		if ( mode == CTL_SETUP ) {
+			gl_update_geometry(c - conf->geometry.virtual_rod_length,
+				a - conf->geometry.suspension_x, b - conf->geometry.suspension_y, conf);
+		} else {
+			conf->geometry.suspension_x = a;
+			conf->geometry.suspension_y = b;
+			conf->geometry.virtual_rod_length = c;
+		}
+		reply(fd, "ok");
+		return UI_INPUT_REDRAW;
+
+	} else if ( strcmp(line, "setup") == 0 || strcmp(line, "start") == 0 ) {
+		const int release = strcmp(line, "start") == 0;
+		if ( mode == CTL_SIM || (mode == CTL_SETUP && !release) ) {
+			reply(fd, "err busy");
+			return UI_INPUT_KEY;
+		}
+		if ( job_active != NULL ) {
+			reply(fd, "err job %u running", job_active->id);
+			return UI_INPUT_KEY;
+		}
+		reply(fd, "ok");
+		if ( mode == CTL_SETUP ) {
+			setupflag = 1;
+			return UI_INPUT_KEY;
+		}
+		release_pending = release;
+		return UI_INPUT_START;
+
+	} else if ( strcmp(line, "stop") == 0 ) {
+		if ( mode == CTL_IDLE ) {
+			if ( job_active == NULL ) {
+				reply(fd, "err idle");
+				return UI_INPUT_KEY;
+			}
+			ctl_job_cancel();
+			reply(fd, "ok");
+			return UI_INPUT_KEY;
+		}
+		simflag = 1;
+		reply(fd, "ok");
+
+	} else if ( sscanf(line, "job %63s %lf %lf %127s", name, &a, &b, file) == 4 ) {
+		ctl_job* job = job_slot();
+		if ( a <= 0.0 || b <= 0.0 ) {
+			reply(fd, "err duration and rate must be positive");
+			return UI_INPUT_KEY;
+		}
+		if ( a > CTL_JOB_DURATION_MAX || a * b > CTL_JOB_SAMPLES_MAX ) {
+			reply(fd, "err at most %.0f s and %u samples", CTL_JOB_DURATION_MAX, CTL_JOB_SAMPLES_MAX);
+			return UI_INPUT_KEY;
+		}
+		if ( !configuration_exists(name) ) {
+			reply(fd, "err no configuration %s", name);
+			return UI_INPUT_KEY;
+		}
+		if ( job == NULL ) {
+			reply(fd, "err queue full");
+			return UI_INPUT_KEY;
+		}
+		memset(job, 0, sizeof(ctl_job));
+		job->status = JOB_QUEUED;
+		job->id = job_next_id++;
+		snprintf(job->configname, sizeof(job->configname), "%s", name);
+		job->duration = a;
+		job->rate = b;
+		snprintf(job->filename, sizeof(job->filename), "%s", file);
+		reply(fd, "ok %u", job->id);
+
+	} else if ( sscanf(line, "result %u", &id) == 1 ) {
+		const ctl_job* job = job_find(id);
+		if ( job == NULL ) {
+			reply(fd, "err unknown job");
+			return UI_INPUT_KEY;
+		}
+		reply(fd, "ok %u %s %u %f %f %f %f %f", job->id, job_status_names[job->status], job->samples,
+			job->time, job->angle, job->velocity, job->energy, job->initial_energy);
+
+	} else if ( strcmp(line, "quit") == 0 ) {
+		simflag = 1;
+		stopflag = 1;
+		reply(fd, "ok");
+
+	} else {
+		reply(fd, "err unknown command");
+	}
+
+	return UI_INPUT_KEY;
+}
+
+/* accept clients and execute complete command lines, returns the strongest UI_INPUT_* */
+int ctl_handle (pendulum_configuration* conf, int mode) {
+
+	int result = UI_INPUT_NONE;
+	unsigned int i;
+
+	if ( listen_fd == -1 )
+		return result;
+
+	int fd;
+	while ( (fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1 ) {
+		for ( i = 0; i < CTL_CLIENTS && clients[i].fd != -1; i++ );
+		if ( i == CTL_CLIENTS || ev_add(fd, EV_CTL) ) {
+			reply(fd, "err too many clients");
+			close(fd);
+			continue;
+		}
+		clients[i].fd = fd;
+		clients[i].length = 0;
+	}
+
+	for ( i = 0; i < CTL_CLIENTS; i++ ) {
+		if ( clients[i].fd == -1 )
+			continue;
+
+		const ssize_t count = read(clients[i].fd, clients[i].line + clients[i].length,
+			CTL_LINE - 1 - clients[i].length);
+		if ( count == 0 || (count < 0 && errno != EAGAIN) ) {
+			client_close(i);
+			continue;
+		}
+		if ( count < 0 )
+			continue;
+		clients[i].length += count;
+
+		// execute every complete line, a line filling the buffer is discarded
+
+		char* start = clients[i].line;
+		char* end;
+		while ( (end = memchr(start, '\n', clients[i].line + clients[i].length - start)) != NULL ) {
+			*end = '\0';
+			if ( end > start && end[-1] == '\r' )
+				end[-1] = '\0';
+			if ( *start != '\0' ) {
+				const int input = command(clients[i].fd, start, conf, mode);
+				if ( input > result )
+					result = input;
+				if ( input == UI_INPUT_START )
+					mode = CTL_SETUP;
+			}
+			start = end + 1;
+		}
+
+		clients[i].length -= start - clients[i].line;
+		memmove(clients[i].line, start, clients[i].length);
+		if ( clients[i].length == CTL_LINE - 1 ) {
+			reply(clients[i].fd, "err line too long");
+			clients[i].length = 0;
+		}
+	}
+
+	return result;
+}
+
+/* release right after entering setup ("start" command), called once per setup */
+int ctl_take_release () {
+	const int release = release_pending;
+	release_pending = 0;
+	return release;
+}
+
+int ctl_job_pending () {
+
+	if ( job_active != NULL )
+		return 1;
+
+	unsigned int i;
+	for ( i = 0; i < CTL_JOBS; i++ )
+		if ( jobs[i].status == JOB_QUEUED )
+			return 1;
+	return 0;
+}
+
+static void job_finish (CTL_JOB_T status) {
+
+	job_active->status = status;
+	sol_solver_terminate(&job_conf);
+	if ( job_file != NULL ) fclose(job_file);
+	job_file = NULL;
+
+	ui_print("job %u %s (%u samples)\r\n", job_active->id, job_status_names[status], job_active->samples);
+	job_active = NULL;
+}
+
+/* the running job fails, e.g. before a run takes over the shared solver */
+void ctl_job_cancel () {
+	if ( job_active != NULL )
+		job_finish(JOB_FAILED);
+}
+
+/* open the oldest queued job and record its initial state */
+static void job_start () {
+
+	ctl_job* job = NULL;
+	unsigned int i;
+	for ( i = 0; i < CTL_JOBS; i++ )
+		if ( jobs[i].status == JOB_QUEUED && (job == NULL || jobs[i].id < job->id) )
+			job = &jobs[i];
+	if ( job == NULL )
+		return;
+
+	job->status = JOB_RUNNING;
+
+	FILE* file = NULL;
+	if ( strcmp(job->filename, "-") != 0 && (file = fopen(job->filename, "w")) == NULL ) {
+		ui_print("job %u: cannot open %s\r\n", job->id, job->filename);
+		job->status = JOB_FAILED;
+		return;
+	}
+
+	const int reset = job_conf.temp.driver == NULL ? PAR_RESET : PAR_NOT_RESET;
+	if ( par_load_configuration(job->configname, &job_conf, reset) || sol_solver_init(&job_conf) ) {
+		ui_print("job %u: configuration %s failed\r\n", job->id, job->configname);
+		job->status = JOB_FAILED;
+		if ( file != NULL ) fclose(file);
+		return;
+	}
+
+	job_active = job;
+	job_file = file;
+	job_sample = 0;
+	job_samples = (unsigned int) (job->duration * job->rate);
+	job->initial_energy = job_conf.temp.energy_initial;
+}
+
+static void job_record () {
+
+	ctl_job* job = job_active;
+	job->samples = job_sample + 1;
+	job->time = job_conf.temp.time;
+	job->angle = job_conf.temp.angle;
+	job->velocity = job_conf.temp.velocity;
+	job->energy = job_conf.temp.energy;
+	if ( job_file != NULL )
+		fprintf(job_file, "%f %f %f %f\n", job->time, job->angle, job->velocity, job->energy);
+}
+
+/* advance the running job (or start the oldest queued one) for at most CTL_JOB_SLICE s,
+ * only while no run is active (the solver is shared) */
+void ctl_job_run () {
+
+	if ( job_active == NULL ) {
+		job_start();
+		if ( job_active == NULL )
+			return;
+		job_record();
+	}
+
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	do {
+		if ( job_sample >= job_samples ) {
+			job_finish(JOB_DONE);
+			return;
+		}
+
+		// long sample intervals are solved in parts to keep the slice short
+		const double t_sample = (job_sample + 1) / job_active->rate;
+		const double t_step = job_conf.temp.time + CTL_JOB_STEP;
+		sol_set_time_next_frame(t_step < t_sample ? t_step : t_sample);
+		sol_solve_next_frame(&job_conf);
+
+		if ( simflag ) {
+			simflag = 0;
+			job_finish(JOB_FAILED);
+			return;
+		}
+
+		if ( t_step >= t_sample ) {
+			job_sample++;
+			job_record();
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ( !stopflag && (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 1.0e-9 < CTL_JOB_SLICE );
+}
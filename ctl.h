@@ -0,0 +1,41 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEN_CTL
+#define PEN_CTL
+
+#include "ev.h"
+#include "par.h"
+
+#define CTL_PATH "/tmp/pendulum.sock"
+#define EV_CTL EV_USER // control socket and its clients
+
+/* program state, decides which commands are accepted */
+#define CTL_IDLE 0
+#define CTL_SETUP 1
+#define CTL_SIM 2
+
+int ctl_init (const char* path);
+void ctl_terminate ();
+int ctl_handle (pendulum_configuration* conf, int mode);
+int ctl_take_release ();
+int ctl_job_pending ();
+void ctl_job_run ();
+void ctl_job_cancel ();
+
+#endif
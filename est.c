@@ -0,0 +1,232 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "est.h"
+#include "sol.h"
+#include "ui.h"
+
+#define EST_STEP 2.0e-3 // s, longest runge-kutta step of the prediction
+#define EST_LINE 128
+#define EST_STATES 3
+
+/*
+ * extended kalman filter keeping the simulation on measured angles
+ *
+ * the state is angle, velocity and (optionally) the linear friction
+ * coefficient as random walk, the model predicts it from one measurement
+ * to the next with runge-kutta steps while the covariance follows the
+ * linearisation of the model (jac), every measured angle then corrects the
+ * state and the solver continues from it, a measurement costs a few fixed
+ * size matrix operations and no allocations
+ *
+ * measurements are read from a fifo as lines "t angle", t in seconds after
+ * the release (see sol_set_start_time) and angle in rad
+ */
+static struct {
+	int fd;
+	unsigned int length;
+	char line[EST_LINE];
+	pendulum_configuration model; // copy with the estimated friction
+	double x[EST_STATES]; // angle, velocity, friction_linear
+	double P[EST_STATES][EST_STATES];
+	double time;
+	unsigned int states; // 2, or 3 with friction
+	unsigned long count;
+	double friction; // configured value, restored at the end of the run
+} est = { .fd = -1 };
+
+int est_start (pendulum_configuration* conf) {
+
+	if ( !conf->estimation.enabled )
+		return 0;
+
+	// a fifo, opened for writing as well so it never reaches end of file without writers
+	if ( mkfifo(conf->estimation.source, 0666) && errno != EEXIST ) {
+		perror("mkfifo");
+		return -1;
+	}
+	est.fd = open(conf->estimation.source, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if ( est.fd == -1 ) {
+		perror("open");
+		return -1;
+	}
+	if ( ev_add(est.fd, EV_EST) ) {
+		close(est.fd);
+		est.fd = -1;
+		return -1;
+	}
+
+	memcpy(&est.model, conf, sizeof(pendulum_configuration));
+	est.model.model.base.params = &est.model;
+	est.model.temp.friction_direction = 0.0;
+	est.states = conf->estimation.friction ? 3 : 2;
+	est.length = 0;
+	est.count = 0;
+	est.friction = conf->bearing.friction_linear;
+
+	// released at rest, the friction is known as well as the measurement allows
+	memset(est.P, 0, sizeof(est.P));
+	est.x[0] = conf->temp.angle;
+	est.x[1] = 0.0;
+	est.x[2] = conf->bearing.friction_linear;
+	est.P[0][0] = conf->estimation.measurement_noise * conf->estimation.measurement_noise;
+	est.P[1][1] = est.P[0][0];
+	est.P[2][2] = conf->bearing.friction_linear * conf->bearing.friction_linear;
+	est.time = 0.0;
+
+	return 0;
+}
+
+/* model and covariance from est.time to "time" */
+static void predict (double time) {
+
+	const gsl_odeiv2_system* system = &(est.model.model.base);
+	const double span = time - est.time;
+	const unsigned int steps = (unsigned int) ceil(span / EST_STEP);
+	const double h = span / steps;
+	const double q = est.model.estimation.process_noise * est.model.estimation.process_noise;
+	const double r = est.model.estimation.friction_noise * est.model.estimation.friction_noise;
+	unsigned int n, i, j, k;
+
+	for ( n = 0; n < steps; n++ ) {
+		const double t0 = est.time + n * h;
+
+		// F = I + A h, with the jacobian and the derivative of the acceleration by the friction
+		double J[4], dfdt[2], F[EST_STATES][EST_STATES], FP[EST_STATES][EST_STATES];
+		system->jacobian(t0, est.x, J, dfdt, system->params);
+		memset(F, 0, sizeof(F));
+		F[0][0] = 1.0;
+		F[0][1] = h;
+		F[1][0] = J[2] * h;
+		F[1][1] = 1.0 + J[3] * h;
+		F[1][2] = - est.x[1] / est.model.temp.moment_of_inertia * h;
+		F[2][2] = 1.0;
+
+		for ( i = 0; i < est.states; i++ )
+			for ( j = 0; j < est.states; j++ ) {
+				FP[i][j] = 0.0;
+				for ( k = 0; k < est.states; k++ )
+					FP[i][j] += F[i][k] * est.P[k][j];
+			}
+		for ( i = 0; i < est.states; i++ )
+			for ( j = 0; j < est.states; j++ ) {
+				est.P[i][j] = 0.0;
+				for ( k = 0; k < est.states; k++ )
+					est.P[i][j] += FP[i][k] * F[j][k];
+			}
+		est.P[1][1] += q * h;
+		if ( est.states == 3 )
+			est.P[2][2] += r * h;
+
+		double time_step = t0;
+		sol_rk4_fixed(system, &time_step, est.x, h, 1);
+	}
+
+	est.time = time;
+}
+
+/* correct the state by a measured angle */
+static void update (double angle) {
+
+	const double R = est.model.estimation.measurement_noise * est.model.estimation.measurement_noise;
+	unsigned int i, j;
+
+	// the simulated angle is not wrapped, the measured one may be
+	const double innovation = remainder(angle - est.x[0], 2.0 * M_PI);
+	const double S = est.P[0][0] + R;
+
+	double K[EST_STATES], row[EST_STATES];
+	for ( i = 0; i < est.states; i++ ) {
+		K[i] = est.P[i][0] / S;
+		row[i] = est.P[0][i];
+	}
+	for ( i = 0; i < est.states; i++ ) {
+		est.x[i] += K[i] * innovation;
+		for ( j = 0; j < est.states; j++ )
+			est.P[i][j] -= K[i] * row[j];
+	}
+
+	if ( est.states == 3 ) {
+		if ( est.x[2] < 0.0 )
+			est.x[2] = 0.0;
+		est.model.bearing.friction_linear = est.x[2];
+	}
+}
+
+/* read every pending measurement, the solver continues from the last estimate */
+void est_handle (pendulum_configuration* conf) {
+
+	if ( est.fd == -1 )
+		return;
+
+	char buffer[512];
+	ssize_t size;
+	unsigned long before = est.count;
+	while ( (size = read(est.fd, buffer, sizeof(buffer))) > 0 ) {
+		ssize_t i;
+		for ( i = 0; i < size; i++ ) {
+			if ( buffer[i] != '\n' ) {
+				if ( est.length < EST_LINE - 1 )
+					est.line[est.length++] = buffer[i];
+				continue;
+			}
+			est.line[est.length] = '\0';
+			est.length = 0;
+
+			double time, angle;
+			if ( sscanf(est.line, "%lf %lf", &time, &angle) != 2 || !(time > est.time) )
+				continue;
+			predict(time);
+			update(angle);
+			est.count++;
+		}
+	}
+
+	if ( est.count == before )
+		return;
+
+	if ( est.states == 3 )
+		conf->bearing.friction_linear = est.x[2];
+	sol_set_state(conf, est.time, est.x[0], est.x[1]);
+}
+
+void est_stop (pendulum_configuration* conf) {
+
+	if ( est.fd == -1 )
+		return;
+
+	ev_remove(est.fd);
+	close(est.fd);
+	est.fd = -1;
+
+	if ( est.states == 3 ) {
+		ui_print("estimated friction_linear: %g +- %g (%lu measurements)\r\n",
+			est.x[2], sqrt(est.P[2][2]), est.count);
+		conf->bearing.friction_linear = est.friction;
+	} else {
+		ui_print("%lu measurements\r\n", est.count);
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEN_EST
+#define PEN_EST
+
+#include "ev.h"
+#include "par.h"
+
+#define EV_EST (EV_USER << 1) // measured angles
+
+int est_start (pendulum_configuration* conf);
+void est_handle (pendulum_configuration* conf);
+void est_stop (pendulum_configuration* conf);
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "ev.h"
+#include "pen.h"
+#include "ui.h"
+
+#define EV_MAX_EVENTS 16
+
+/*
+ * one epoll instance multiplexes keyboard, signals (signalfd), the timer
+ * (timerfd) and any further descriptor, the program sleeps in ev_wait
+ * whenever there is nothing to do
+ */
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static int timer_fd = -1;
+
+int ev_add (int fd, int event) {
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = event;
+
+	if ( epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) ) {
+		perror("epoll_ctl");
+		return -1;
+	}
+
+	return 0;
+}
+
+int ev_remove (int fd) {
+	return epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int ev_init () {
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if ( epoll_fd == -1 ) {
+		perror("epoll_create1");
+		return -1;
+	}
+
+	// signals are no longer delivered asynchronously but read from a descriptor
+
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGQUIT);
+	sigaddset(&mask, SIGTERM);
+
+	if ( sigprocmask(SIG_BLOCK, &mask, NULL) ) {
+		perror("sigprocmask");
+		return -1;
+	}
+
+	signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if ( signal_fd == -1 ) {
+		perror("signalfd");
+		return -1;
+	}
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if ( timer_fd == -1 ) {
+		perror("timerfd_create");
+		return -1;
+	}
+
+	if ( ev_add(signal_fd, EV_SIGNAL) || ev_add(timer_fd, EV_TICK) )
+		return -1;
+
+	// stdin may be a regular file or /dev/null (e.g. video export), which epoll refuses
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u32 = EV_INPUT;
+	if ( epoll_ctl(epoll_fd, EPOLL_CTL_ADD, 0, &ev) && errno != EPERM ) {
+		perror("epoll_ctl");
+		return -1;
+	}
+
+	return 0;
+}
+
+void ev_terminate () {
+
+	if ( timer_fd != -1 ) close(timer_fd);
+	if ( signal_fd != -1 ) close(signal_fd);
+	if ( epoll_fd != -1 ) close(epoll_fd);
+	timer_fd = signal_fd = epoll_fd = -1;
+}
+
+/* periodic EV_TICK every "period" seconds */
+int ev_timer_start (double period) {
+
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = (time_t) period;
+	spec.it_interval.tv_nsec = (long) ((period - (time_t) period) * 1.0e9);
+	spec.it_value = spec.it_interval;
+
+	if ( timerfd_settime(timer_fd, 0, &spec, NULL) ) {
+		perror("timerfd_settime");
+		return -1;
+	}
+
+	return 0;
+}
+
+void ev_timer_stop () {
+
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	timerfd_settime(timer_fd, 0, &spec, NULL);
+}
+
+/* wait up to "timeout" ms (-1 forever, 0 just check) and return the pending events */
+int ev_wait (int timeout) {
+
+	struct epoll_event events[EV_MAX_EVENTS];
+	int i, result = 0;
+
+	const int count = epoll_wait(epoll_fd, events, EV_MAX_EVENTS, timeout);
+
+	for ( i = 0; i < count; i++ ) {
+		const int event = events[i].data.u32;
+
+		if ( event == EV_SIGNAL ) {
+			struct signalfd_siginfo info;
+			while ( read(signal_fd, &info, sizeof(info)) == sizeof(info) ) {
+				ui_print("program aborted (signal %u)!\n\r", info.ssi_signo);
+				stopflag = 1;
+			}
+		} else if ( event == EV_TICK ) {
+			uint64_t expirations;
+			if ( read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations) )
+				continue;
+		}
+
+		result |= event;
+	}
+
+	return result;
+}
@@ -0,0 +1,36 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEN_EV
+#define PEN_EV
+
+/* event sources, returned as bit mask by ev_wait */
+#define EV_INPUT	0x01	// keyboard input on stdin
+#define EV_SIGNAL	0x02	// SIGINT, SIGQUIT or SIGTERM (sets stopflag)
+#define EV_TICK		0x04	// periodic timer, see ev_timer_start
+#define EV_USER		0x10	// first bit for further file descriptors
+
+int ev_init ();
+void ev_terminate ();
+int ev_add (int fd, int event);
+int ev_remove (int fd);
+int ev_timer_start (double period);
+void ev_timer_stop ();
+int ev_wait (int timeout);
+
+#endif
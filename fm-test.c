@@ -0,0 +1,102 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fm.h"
+
+/*
+ * every single precision value in [0, FM_REDUCE_MAX) and its negative is
+ * checked against libm, for each tier the largest absolute errors of
+ * fm_sin, fm_cos and fm_sincos must stay below the bound
+ */
+
+typedef struct {
+	const char* name;
+	fm_accuracy accuracy;
+	double bound;
+	double error, at;
+} tier;
+
+static inline void check (tier* t, double x, double error) {
+	if ( error > t->error ) {
+		t->error = error;
+		t->at = x;
+	}
+}
+
+/* usage: fm-test [stride], stride 1 is exhaustive */
+int main (int argc, char *argv[]) {
+
+	const unsigned int stride = argc > 1 ? atoi(argv[1]) : 1;
+	if ( stride == 0 ) {
+		fprintf(stderr, "stride must be positive!\n");
+		return(1);
+	}
+
+	tier tiers[] = {
+		{ "1e-12", FM_1E12, 1.0e-12, 0.0, 0.0 },
+		{ "1e-7", FM_1E7, 1.0e-7, 0.0, 0.0 }
+	};
+	const unsigned int count = sizeof(tiers) / sizeof(tiers[0]);
+
+	float limit = FM_REDUCE_MAX;
+	unsigned int bits, end;
+	memcpy(&end, &limit, sizeof(end));
+
+	unsigned long n = 0;
+	for ( bits = 0; bits < end; bits += stride, n++ ) {
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		const double x = f, s = sin(x), c = cos(x);
+
+		unsigned int i;
+		for ( i = 0; i < count; i++ ) {
+			tier* t = &tiers[i];
+			double fs, fc, ns, nc;
+			fm_sincos(x, &fs, &fc, t->accuracy);
+			fm_sincos(-x, &ns, &nc, t->accuracy);
+			check(t, x, fmax(fabs(fs - s), fabs(fc - c)));
+			check(t, -x, fmax(fabs(ns + s), fabs(nc - c)));
+			check(t, x, fmax(fabs(fm_sin(x, t->accuracy) - s), fabs(fm_cos(x, t->accuracy) - c)));
+			check(t, -x, fmax(fabs(fm_sin(-x, t->accuracy) + s), fabs(fm_cos(-x, t->accuracy) - c)));
+		}
+	}
+
+	int failed = 0;
+	unsigned int i;
+	for ( i = 0; i < count; i++ ) {
+		printf("%-6s max error %.3e at %.9g (bound %.0e) over %lu arguments\n", tiers[i].name,
+			tiers[i].error, tiers[i].at, tiers[i].bound, 2 * n);
+		failed |= !(tiers[i].error < tiers[i].bound);
+	}
+
+	if ( failed )
+		fprintf(stderr, "error bound exceeded!\n");
+
+	// the finite check has to survive the finite math of -Ofast
+	volatile double huge = 1.0e308, zero = 0.0;
+	if ( !fm_finite(huge) || fm_finite(huge * 10.0) || fm_finite(zero / zero) ) {
+		fprintf(stderr, "fm_finite folded!\n");
+		failed = 1;
+	}
+
+	return(failed);
+}
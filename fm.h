@@ -0,0 +1,140 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef PEN_FM
+#define PEN_FM
+
+#include <math.h>
+
+/*
+ * sin and cos in accuracy tiers for the right hand sides (see fm-test.c)
+ *
+ * FM_FULL is libm, the other tiers reduce the argument by multiples of
+ * pi/2 (pi/2 split in 33 + 33 bits + tail, exact for |x| < FM_REDUCE_MAX,
+ * libm beyond) and evaluate polynomials on [-pi/4, pi/4], chebyshev
+ * interpolants of the taylor remainders in r^2, the absolute errors are
+ * below 1e-12 and 1e-7, inlined since a call costs what they save
+ */
+typedef enum { FM_FULL, FM_1E12, FM_1E7 } fm_accuracy;
+
+#define FM_REDUCE_MAX 1.0e5
+#define FM_PIO2_1 1.57079632673412561417e+00 // first 33 bits of pi/2
+#define FM_PIO2_2 6.07710050630396597660e-11 // second 33 bits
+#define FM_PIO2_2T 2.02226624879595063154e-21 // pi/2 - FM_PIO2_1 - FM_PIO2_2
+
+/* hides a value from the optimizer, -Ofast would otherwise reassociate the reduction */
+#if defined(__x86_64__)
+#define FM_BARRIER(x) __asm__ ("" : "+x" (x))
+#elif defined(__arm__) || defined(__aarch64__)
+#define FM_BARRIER(x) __asm__ ("" : "+w" (x))
+#else
+#define FM_BARRIER(x) __asm__ ("" : "+m" (x))
+#endif
+
+/* isfinite from the exponent bits, -Ofast (finite math only) folds isfinite to true */
+static inline int fm_finite (double x) {
+	union { double value; unsigned long long bits; } u = { x };
+	return (u.bits >> 52 & 0x7ff) != 0x7ff;
+}
+
+/* tier of the required absolute accuracy (<= 0 for libm) */
+static inline fm_accuracy fm_tier (double accuracy) {
+	if ( accuracy >= 1.0e-7 )
+		return FM_1E7;
+	if ( accuracy >= 1.0e-12 )
+		return FM_1E12;
+	return FM_FULL;
+}
+
+/* r in [-pi/4, pi/4] with x = r + k pi/2, returns k mod 4 */
+static inline unsigned int fm_reduce (double x, double* r) {
+	const int k = (int) (x * M_2_PI + (x < 0.0 ? -0.5 : 0.5));
+	double high = x - k * FM_PIO2_1; // exact
+	FM_BARRIER(high);
+	*r = (high - k * FM_PIO2_2) - k * FM_PIO2_2T;
+	return (unsigned int) k & 3;
+}
+
+/* sin(r) and cos(r) on the reduced interval, z = r^2 */
+static inline double fm_sin_reduced (double r, double z, fm_accuracy accuracy) {
+	if ( accuracy == FM_1E7 )
+		return r + r * z * (-0.1666666466231437 + z * (0.0083327482706292717 + z * -0.00019587890880348567));
+	return r + r * z * (-0.16666666666663885 + z * (0.0083333333310793515 + z * (-0.00019841266917429797
+		+ z * (2.7555991098132202e-06 + z * -2.4805652868321422e-08))));
+}
+
+static inline double fm_cos_reduced (double z, fm_accuracy accuracy) {
+	if ( accuracy == FM_1E7 )
+		return 1.0 - 0.5 * z + z * z * (0.041666664659502209 + z * (-0.0013888303035894823 + z * 2.454794208505312e-05));
+	return 1.0 - 0.5 * z + z * z * (0.04166666666666468 + z * (-0.0013888888887277455 + z * (2.4801585211118018e-05
+		+ z * (-2.7556369748424511e-07 + z * 2.0700605561938452e-09))));
+}
+
+static inline double fm_sin (double x, fm_accuracy accuracy) {
+
+	if ( accuracy == FM_FULL || !(fabs(x) < FM_REDUCE_MAX) )
+		return sin(x);
+
+	double r;
+	const unsigned int quadrant = fm_reduce(x, &r);
+	const double z = r * r;
+	switch ( quadrant ) {
+		case 0: return fm_sin_reduced(r, z, accuracy);
+		case 1: return fm_cos_reduced(z, accuracy);
+		case 2: return - fm_sin_reduced(r, z, accuracy);
+		default: return - fm_cos_reduced(z, accuracy);
+	}
+}
+
+static inline double fm_cos (double x, fm_accuracy accuracy) {
+
+	if ( accuracy == FM_FULL || !(fabs(x) < FM_REDUCE_MAX) )
+		return cos(x);
+
+	double r;
+	const unsigned int quadrant = fm_reduce(x, &r);
+	const double z = r * r;
+	switch ( quadrant ) {
+		case 0: return fm_cos_reduced(z, accuracy);
+		case 1: return - fm_sin_reduced(r, z, accuracy);
+		case 2: return - fm_cos_reduced(z, accuracy);
+		default: return fm_sin_reduced(r, z, accuracy);
+	}
+}
+
+/* both with one reduction */
+static inline void fm_sincos (double x, double* s, double* c, fm_accuracy accuracy) {
+
+	if ( accuracy == FM_FULL || !(fabs(x) < FM_REDUCE_MAX) ) {
+		*s = sin(x);
+		*c = cos(x);
+		return;
+	}
+
+	double r;
+	const unsigned int quadrant = fm_reduce(x, &r);
+	const double z = r * r;
+	const double sr = fm_sin_reduced(r, z, accuracy), cr = fm_cos_reduced(z, accuracy);
+	switch ( quadrant ) {
+		case 0: *s = sr; *c = cr; break;
+		case 1: *s = cr; *c = - sr; break;
+		case 2: *s = - sr; *c = - cr; break;
+		default: *s = - cr; *c = sr; break;
+	}
+}
+
+#endif
@@ -17,6 +17,7 @@
  */
 
 #include <stdio.h>
+#include <math.h>
 #include <time.h>
 
 #include "gl.h"
@@ -26,6 +27,8 @@ inline double time_substract (struct timespec* time_later, struct timespec* time
 	return (time_later->tv_sec - time_earlier->tv_sec) + (time_later->tv_nsec - time_earlier->tv_nsec)/1.0e9;
 }
 
+#define ENSEMBLE_SIZE 1024
+
 int main ( int argc, char *argv[] ) {	
 
 	if ( gl_init() ) {
@@ -33,18 +36,39 @@ int main ( int argc, char *argv[] ) {
 		return -1;
 	}
 
-	struct timespec time_now, time_final;
+	// a fan of pendulums with slightly different frequencies
+
+	float angles[ENSEMBLE_SIZE];
+	int i, frames = 0;
 
-	clock_gettime(CLOCK_MONOTONIC, &time_final);
+	if ( gl_ensemble_init(ENSEMBLE_SIZE) ) {
+		fprintf(stderr,"ensemble seems not to work.\n");
+		gl_terminate();
+		return -1;
+	}
+	for ( i = 0; i < ENSEMBLE_SIZE; i++ )
+		gl_ensemble_set_instance(i, 0.0f, 0.0f, 0.8f, (float) i / ENSEMBLE_SIZE, 0.3f, 1.0f, 0.1f);
+
+	struct timespec time_now, time_start, time_final;
+
+	clock_gettime(CLOCK_MONOTONIC, &time_start);
+	time_final = time_start;
 	time_final.tv_sec += 10;
 
 	clock_gettime(CLOCK_MONOTONIC, &time_now);
 	while ( time_substract(&time_final,&time_now) > 0 ) {
+		const double t = time_substract(&time_now,&time_start);
+		for ( i = 0; i < ENSEMBLE_SIZE; i++ )
+			angles[i] = 0.8f * cosf((6.0f + 0.002f * i) * t);
+		gl_ensemble_update(angles);
 		gl_draw_frame(0.3);
+		frames++;
 		clock_gettime(CLOCK_MONOTONIC, &time_now);
-		fprintf(stderr,"bla.\n");
 	}
 
+	fprintf(stderr,"%d pendulums, %.1f frames per second.\n", ENSEMBLE_SIZE,
+		frames / time_substract(&time_now,&time_start));
+
 	gl_terminate();
 
 	return 0;
@@ -17,69 +17,319 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
 
 #include "gl_tools.h"
 #include "gl_geometries.h"
 #include "gl.h"
 #include "par.h"
+#include "fm.h"
 
 #define PEN_GL_SUSPX 0.0f
 #define PEN_GL_SUSPY 0.0f
 
+#define PEN_GL_ENSEMBLE_MAX 4096 // limited by unsigned short indices
+#define PEN_GL_TRAIL_LENGTH 2048 // states in the trail ring
+#define PEN_GL_VBLANK_FRAMES 16 // swaps timed by gl_vblank_measure, the first half fills the swap queue
+#define PEN_GL_VBLANK_MARGIN 0.002 // s, minimum time left to schedule something before a vblank
+#define PEN_GL_VBLANK_PERIOD_MIN (1.0 / 240.0) // s, plausible refresh periods
+#define PEN_GL_VBLANK_PERIOD_MAX (1.0 / 20.0)
+#define PEN_GL_VBLANK_RESIDUAL 0.1 // rms deviation of the swaps from the fit, in periods
+#define PEN_GL_BAND_FAN 9 // pendulums spanning the uncertainty band
+
 static CUBE_STATE_T gl_state;
 geometry_data geometry;
+static float pendulum_rodlen = 1.0f;
+
+/* per instance data of the ensemble, interleaved for the instance buffer */
+typedef struct {
+	GLfloat pivot_x;
+	GLfloat pivot_y;
+	GLfloat rodlen;
+	GLubyte color[4];
+} ensemble_instance;
+
+static struct {
+	unsigned int count;
+	unsigned int vertices_per_instance;
+	geometry_data geometry;
+	GLfloat* angles; /* one angle per vertex, streamed every frame */
+	ensemble_instance* instances; /* one record per vertex */
+	int instances_dirty;
+} ensemble;
+
+/* n-link model, drawn as ensemble with one instance per link */
+static unsigned int links_count = 0;
+
+/* uncertainty band of the single pendulum, drawn as a translucent fan of the ensemble */
+static int band = 0;
+
+static void band_instances () {
+	unsigned int i;
+	for ( i = 0; i < PEN_GL_BAND_FAN; i++ )
+		gl_ensemble_set_instance(i, 0.0f, 0.0f, pendulum_rodlen, 0.3f, 0.6f, 1.0f, 0.15f);
+}
+
+/* swap timing, with vsync the end of a swap is close to a vblank */
+static struct {
+	double period; // s, 0 if not measured
+	struct timespec last; // end of the last swap
+} vblank;
+
+/* ring of recent states, slot "length" mirrors slot 0 so the line strip wraps */
+static struct {
+	unsigned int head;
+	unsigned int count;
+	int trail;
+	int phase;
+} trail;
+
+static void draw_trail () {
+
+	CUBE_STATE_T* state = &gl_state;
+
+	glUseProgram(state->trail_program);
+	glBindBuffer(GL_ARRAY_BUFFER, state->trail_buffer);
+	glVertexAttribPointer(state->trail_attr_state, 3, GL_FLOAT, GL_FALSE, 0, (void*) 0);
+	glEnableVertexAttribArray(state->trail_attr_state);
+	glUniform1f(state->trail_unif_head, (GLfloat) trail.head);
+	check();
+
+	int mode;
+	for ( mode = 0; mode < 2; mode++ ) {
+		if ( mode == 0 && !trail.trail ) continue;
+		if ( mode == 1 && !trail.phase ) continue;
+
+		glUniform1f(state->trail_unif_mode, (GLfloat) mode);
+
+		// oldest part first (only after the ring wrapped), then up to the newest state
+		if ( trail.count == PEN_GL_TRAIL_LENGTH )
+			glDrawArrays(GL_LINE_STRIP, trail.head + 1, PEN_GL_TRAIL_LENGTH - trail.head);
+		glDrawArrays(GL_LINE_STRIP, 0, trail.head + 1);
+		check();
+	}
+
+	glDisableVertexAttribArray(state->trail_attr_state);
+
+	// restore the pendulum program and buffers
+
+	glUseProgram(state->program);
+	glBindBuffer(GL_ARRAY_BUFFER, state->buffers[0]);
+	glVertexAttribPointer(state->attr_vertex, 3, GL_FLOAT, GL_FALSE, geometry.stride, (void *) geometry.vertex_offset);
+	glEnableVertexAttribArray(state->attr_vertex);
+	check();
+}
+
+static void draw_ensemble () {
+
+	CUBE_STATE_T* state = &gl_state;
+
+	glUseProgram(state->ensemble_program);
+
+	// angles change every frame, orphan the buffer and stream them
+
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[2]);
+	glBufferData(GL_ARRAY_BUFFER, ensemble.geometry.vertex_count * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, ensemble.geometry.vertex_count * sizeof(GLfloat), ensemble.angles);
+	glVertexAttribPointer(state->ensemble_attr_angle, 1, GL_FLOAT, GL_FALSE, 0, (void*) 0);
+	glEnableVertexAttribArray(state->ensemble_attr_angle);
+	check();
+
+	// pivot, length and color only when changed
+
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[3]);
+	if ( ensemble.instances_dirty ) {
+		glBufferSubData(GL_ARRAY_BUFFER, 0, ensemble.geometry.vertex_count * sizeof(ensemble_instance), ensemble.instances);
+		ensemble.instances_dirty = 0;
+	}
+	glVertexAttribPointer(state->ensemble_attr_pose, 3, GL_FLOAT, GL_FALSE, sizeof(ensemble_instance),
+		(void*) offsetof(ensemble_instance, pivot_x));
+	glVertexAttribPointer(state->ensemble_attr_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ensemble_instance),
+		(void*) offsetof(ensemble_instance, color));
+	glEnableVertexAttribArray(state->ensemble_attr_pose);
+	glEnableVertexAttribArray(state->ensemble_attr_color);
+	check();
+
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->ensemble_buffers[1]);
+	glVertexAttribPointer(state->ensemble_attr_vertex, 3, GL_FLOAT, GL_FALSE, ensemble.geometry.stride, (void*) 0);
+	glEnableVertexAttribArray(state->ensemble_attr_vertex);
+	check();
+
+	// all pendulums in a single call
+
+	glDrawElements(GL_TRIANGLES, ensemble.geometry.element_count * 3, GL_UNSIGNED_SHORT, (void*) 0);
+	check();
+
+	glDisableVertexAttribArray(state->ensemble_attr_angle);
+	glDisableVertexAttribArray(state->ensemble_attr_pose);
+	glDisableVertexAttribArray(state->ensemble_attr_color);
+	glDisableVertexAttribArray(state->ensemble_attr_vertex);
+
+	// restore the pendulum program and buffers
+
+	glUseProgram(state->program);
+	glBindBuffer(GL_ARRAY_BUFFER, state->buffers[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->buffers[1]);
+	glVertexAttribPointer(state->attr_vertex, 3, GL_FLOAT, GL_FALSE, geometry.stride, (void *) geometry.vertex_offset);
+	glEnableVertexAttribArray(state->attr_vertex);
+	check();
+}
 
 void gl_draw_frame (float angle) {
 
 	glClear(GL_COLOR_BUFFER_BIT);
 	check();	
 
-	// hw pendulum (background)
-	glUniform4f(gl_state.unif_color, 0.96f, 0.686f, 0.1176f, 1.0f);
-	glUniform1f(gl_state.unif_rotation, angle);
-	check();	
+	// ensemble and trail (behind the pendulum)
+	if ( ensemble.count > 0 )
+		draw_ensemble();
+	if ( trail.count > 1 && (trail.trail || trail.phase) )
+		draw_trail();
 
-	glDrawElements(GL_TRIANGLES, geometry.element_count * 3, GL_UNSIGNED_SHORT, (void*) 0);
-	check();	
+	// hw pendulum (background), the n-link model replaces it
+	if ( links_count == 0 ) {
+		glUniform4f(gl_state.unif_color, 0.96f, 0.686f, 0.1176f, 1.0f);
+		glUniform1f(gl_state.unif_rotation, angle);
+		check();
+
+		glDrawElements(GL_TRIANGLES, geometry.element_count * 3, GL_UNSIGNED_SHORT, (void*) 0);
+		check();
+	}
 
 	/*
-	 * to draw a second pendulum: 
-	 * glUniform4f ( gl_state.unif_color, 1.0f, 0.0f, 0.0f, 1.0f );
-	 * glUniform1f ( gl_state.unif_rotation, angle + 0.5f );
-	 * glDrawElements ( GL_TRIANGLES, geometry.element_count * 3, GL_UNSIGNED_SHORT, (void*) 0 );
+	 * to draw more pendulums use the ensemble, see gl_ensemble_init
 	 */
 
 	eglSwapBuffers(gl_state.display, gl_state.surface);
 	check();
+	clock_gettime(CLOCK_MONOTONIC, &vblank.last);
 }
 
-void init_shaders(CUBE_STATE_T *state) {
+static double timespec_seconds (const struct timespec* time) {
+	return time->tv_sec + time->tv_nsec / 1.0e9;
+}
 
-	double angle_offset = 0.0f; //TODO
+/*
+ * draw a few frames and fit the swap times linearly (t_i = phase + period * i),
+ * returns the frame period or -1 if the swaps are not synchronised to vblank
+ */
+double gl_vblank_measure (float angle) {
+
+	const unsigned int skip = PEN_GL_VBLANK_FRAMES / 2;
+	const unsigned int count = PEN_GL_VBLANK_FRAMES - skip;
+	struct timespec first;
+	double times[PEN_GL_VBLANK_FRAMES];
+
+	unsigned int i;
+	for ( i = 0; i < PEN_GL_VBLANK_FRAMES; i++ ) {
+		gl_draw_frame(angle);
+		if ( i == skip )
+			first = vblank.last;
+		if ( i >= skip )
+			times[i - skip] = timespec_seconds(&vblank.last) - timespec_seconds(&first);
+	}
+
+	// least squares, relative to the first timed swap
+
+	double mean_i = (count - 1) / 2.0, mean_t = 0.0;
+	for ( i = 0; i < count; i++ )
+		mean_t += times[i] / count;
+
+	double covariance = 0.0, variance = 0.0;
+	for ( i = 0; i < count; i++ ) {
+		covariance += (i - mean_i) * (times[i] - mean_t);
+		variance += (i - mean_i) * (i - mean_i);
+	}
+
+	// unsynchronised swaps take as long as drawing, irregularly and often only a few ms
+	const double period = covariance / variance;
+	double residual = 0.0;
+	for ( i = 0; i < count; i++ ) {
+		const double deviation = times[i] - mean_t - period * (i - mean_i);
+		residual += deviation * deviation / count;
+	}
+	if ( period < PEN_GL_VBLANK_PERIOD_MIN || period > PEN_GL_VBLANK_PERIOD_MAX ||
+			sqrt(residual) > PEN_GL_VBLANK_RESIDUAL * period ) {
+		vblank.period = 0.0;
+		return -1.0;
+	}
+
+	// the fitted time of the last swap is less noisy than the measured one
+
+	const double last = mean_t + period * (count - 1 - mean_i);
+	const long long nsec = (long long) first.tv_sec * 1000000000LL + first.tv_nsec + (long long) (last * 1.0e9);
+	vblank.last.tv_sec = nsec / 1000000000LL;
+	vblank.last.tv_nsec = nsec % 1000000000LL;
+	vblank.period = period;
+
+	return period;
+}
+
+/*
+ * time "lead" seconds before the next vblank that can still be reached,
+ * needs gl_vblank_measure, returns -1 if the swap timing is unknown
+ */
+int gl_vblank_before (double lead, struct timespec* when) {
+
+	if ( vblank.period <= 0.0 )
+		return -1;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	const double earliest = timespec_seconds(&now) - timespec_seconds(&vblank.last) + lead + PEN_GL_VBLANK_MARGIN;
+	const double frames = ceil(earliest / vblank.period);
+	const double offset = (frames > 0.0 ? frames : 0.0) * vblank.period - lead;
+
+	const long long nsec = (long long) vblank.last.tv_sec * 1000000000LL + vblank.last.tv_nsec + (long long) (offset * 1.0e9);
+	when->tv_sec = nsec / 1000000000LL;
+	when->tv_nsec = nsec % 1000000000LL;
+
+	return 0;
+}
+
+static GLuint load_program (const char* vfilename, const char* ffilename, GLuint* vshader, GLuint* fshader) {
 
 	// create shaders
 
-	const GLchar* vshadersource = read_file("gl_pendulum.vshader");
-	const GLchar* fshadersource = read_file("gl_pendulum.fshader");
+	GLchar* vshadersource = read_file(vfilename);
+	GLchar* fshadersource = read_file(ffilename);
 
-	state->vshader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(state->vshader, 1, &vshadersource, 0);
-	glCompileShader(state->vshader);
+	*vshader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(*vshader, 1, (const GLchar**) &vshadersource, 0);
+	glCompileShader(*vshader);
 	check();
 	
-	state->fshader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(state->fshader, 1, &fshadersource, 0);
-	glCompileShader(state->fshader);
+	*fshader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(*fshader, 1, (const GLchar**) &fshadersource, 0);
+	glCompileShader(*fshader);
 	check();
 
+	free(vshadersource);
+	free(fshadersource);
+
 	// create and link shader program
 
-	state->program = glCreateProgram();
-	glAttachShader(state->program, state->vshader);
-	glAttachShader(state->program, state->fshader);
-        glLinkProgram(state->program);
+	GLuint program = glCreateProgram();
+	glAttachShader(program, *vshader);
+	glAttachShader(program, *fshader);
+	glLinkProgram(program);
 	check();
 
+	return program;
+}
+
+void init_shaders(CUBE_STATE_T *state) {
+
+	double angle_offset = 0.0f; //TODO
+
+	state->program = load_program("gl_pendulum.vshader", "gl_pendulum.fshader", &state->vshader, &state->fshader);
+
 	// get attrib and unif locations
 
 	state->attr_vertex = glGetAttribLocation(state->program, "VertexPosition");
@@ -87,6 +337,9 @@ void init_shaders(CUBE_STATE_T *state) {
 	state->unif_translation = glGetUniformLocation(state->program, "Translation");
 	state->unif_screenratio = glGetUniformLocation(state->program, "ScreenRatio");
 	state->unif_color = glGetUniformLocation(state->program, "Color");
+	state->unif_rodlength = glGetUniformLocation(state->program, "RodLength");
+	state->unif_shape = glGetUniformLocation(state->program, "Shape");
+	state->unif_pixelsize = glGetUniformLocation(state->program, "PixelSize");
 	check();
 
 	// set values
@@ -96,9 +349,39 @@ void init_shaders(CUBE_STATE_T *state) {
 	glUniform4f(state->unif_translation, PEN_GL_SUSPX, PEN_GL_SUSPY, 0.0f, 0.0f);
 	glUniform1f(state->unif_rotation, angle_offset);
 	glUniform4f(state->unif_color, 0.0f, 0.0f, 1.0f, 1.0f);
+	glUniform1f(state->unif_rodlength, pendulum_rodlen);
+	glUniform2f(state->unif_shape, PEN_GL_ROD_WIDTH, PEN_GL_BOB_RADIUS);
+	// one unit in pendulum coordinates covers half the screen width
+	glUniform1f(state->unif_pixelsize, 2.0f / (GLfloat) state->screen_width);
+	check();
+
+	// trail and phase portrait
+
+	state->trail_program = load_program("gl_trail.vshader", "gl_trail.fshader", &state->trail_vshader, &state->trail_fshader);
+
+	state->trail_attr_state = glGetAttribLocation(state->trail_program, "State");
+	state->trail_unif_screenratio = glGetUniformLocation(state->trail_program, "ScreenRatio");
+	state->trail_unif_translation = glGetUniformLocation(state->trail_program, "Translation");
+	state->trail_unif_rodlength = glGetUniformLocation(state->trail_program, "RodLength");
+	state->trail_unif_head = glGetUniformLocation(state->trail_program, "Head");
+	state->trail_unif_length = glGetUniformLocation(state->trail_program, "Length");
+	state->trail_unif_mode = glGetUniformLocation(state->trail_program, "Mode");
+	state->trail_unif_scale = glGetUniformLocation(state->trail_program, "Scale");
+	state->trail_unif_color = glGetUniformLocation(state->trail_program, "Color");
+	check();
+
+	glUseProgram(state->trail_program);
+	glUniform1f(state->trail_unif_screenratio, ((GLfloat) state->screen_width)/((GLfloat) state->screen_height));
+	glUniform4f(state->trail_unif_translation, PEN_GL_SUSPX, PEN_GL_SUSPY, 0.0f, 0.0f);
+	glUniform1f(state->trail_unif_length, (GLfloat) PEN_GL_TRAIL_LENGTH);
+	glUniform4f(state->trail_unif_scale, 0.0f, 0.0f, 0.0f, 0.0f);
+	glUniform4f(state->trail_unif_color, 0.96f, 0.686f, 0.1176f, 0.8f);
+	glUseProgram(state->program);
 	check();
 }
 
+static int init_scene (CUBE_STATE_T* state);
+
 int gl_init () {
 
 	CUBE_STATE_T* state = &gl_state;
@@ -109,10 +392,47 @@ int gl_init () {
 	bcm_host_init();
 	init_ogl_ng(state);
 
+	return init_scene(state);
+}
+
+/* render into an offscreen pbuffer of the given size instead of the display */
+int gl_init_offscreen (unsigned int width, unsigned int height) {
+
+	CUBE_STATE_T* state = &gl_state;
+	memset(state, 0, sizeof(gl_state));
+
+	bcm_host_init();
+	if ( init_ogl_pbuffer(state, width, height) ) {
+		fprintf(stderr, "cannot create offscreen surface!\n\r");
+		return -1;
+	}
+
+	return init_scene(state);
+}
+
+/* copy the last drawn frame (RGBA, bottom row first) to "pixels" */
+void gl_read_frame (void* pixels) {
+	glReadPixels(0, 0, gl_state.screen_width, gl_state.screen_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	check();
+}
+
+static int init_scene (CUBE_STATE_T* state) {
+
 	// initialize shaders
 	
 	init_shaders(state);
 
+	// ring buffer for the trail, only single states are uploaded later
+
+	glGenBuffers(1, &state->trail_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, state->trail_buffer);
+	glBufferData(GL_ARRAY_BUFFER, (PEN_GL_TRAIL_LENGTH + 1) * 3 * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	check();
+
+	memset(&trail, 0, sizeof(trail));
+	glLineWidth(2.0f);
+
 	// prepare viewport
 
 	glViewport(0, 0, state->screen_width, state->screen_height);
@@ -124,7 +444,7 @@ int gl_init () {
 
 	// upload vertex data
 
-	GLuint vbo[2];
+	GLuint* vbo = state->buffers;
 	glGenBuffers(2, vbo);
 	check();
 	
@@ -147,9 +467,9 @@ int gl_init () {
 	glUseProgram(state->program);
 	check();
 
-//	glEnable(GL_BLEND);
-//	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-//	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_DST_ALPHA);
+	// translucent ensembles, keep the destination alpha for the transparent display layer
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 //	glEnable(GL_CULL_FACE);
 //	glEnable(GL_DEPTH_TEST);
 //	glDepthRangef(0.0f,5.0f);
@@ -163,6 +483,10 @@ int gl_init () {
 
 int gl_terminate () {
 
+	gl_ensemble_terminate();
+	links_count = 0;
+	band = 0;
+
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	check();
@@ -185,6 +509,7 @@ int gl_terminate () {
 int gl_update_geometry (float rodlen_delta, float x_delta, float y_delta, pendulum_configuration* data) {
 
 	GeometryUpdatePendulum(&geometry, (data->geometry.virtual_rod_length) += rodlen_delta);
+	glBindBuffer(GL_ARRAY_BUFFER, gl_state.buffers[0]);
 	glBufferData(GL_ARRAY_BUFFER, geometry.vertices_size, geometry.vertices, GL_STATIC_DRAW);
 	check();
 
@@ -192,9 +517,53 @@ int gl_update_geometry (float rodlen_delta, float x_delta, float y_delta, pendul
 		(data->geometry.suspension_x) += x_delta, (data->geometry.suspension_y) += y_delta, 0.0f, 0.0f);
 	check();
 
+	pendulum_rodlen = data->geometry.virtual_rod_length;
+	glUniform1f(gl_state.unif_rodlength, pendulum_rodlen);
+
+	glUseProgram(gl_state.trail_program);
+	glUniform1f(gl_state.trail_unif_rodlength, pendulum_rodlen);
+	glUniform4f(gl_state.trail_unif_translation,
+		data->geometry.suspension_x, data->geometry.suspension_y, 0.0f, 0.0f);
+	glUseProgram(gl_state.program);
+	check();
+
+	if ( gl_state.ensemble_program != 0 ) {
+		glUseProgram(gl_state.ensemble_program);
+		glUniform4f(gl_state.ensemble_unif_translation,
+			data->geometry.suspension_x, data->geometry.suspension_y, 0.0f, 0.0f);
+		glUseProgram(gl_state.program);
+		check();
+	}
+
+	// the band follows the rod length
+	if ( band )
+		band_instances();
+
 	return 0;
 }
 
+/* prepare the kept context for a new run */
+void gl_reset (pendulum_configuration* data) {
+
+	if ( data->geometry.transparency == 1 )
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	else
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	check();
+
+	trail.head = 0;
+	trail.count = 0;
+}
+
+/* show an empty (transparent) screen between runs */
+void gl_blank () {
+
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	eglSwapBuffers(gl_state.display, gl_state.surface);
+	check();
+}
+
 void gl_toggle_alpha (pendulum_configuration* data) {
 
 	if ( data->geometry.transparency == 1 ) {
@@ -207,3 +576,245 @@ void gl_toggle_alpha (pendulum_configuration* data) {
 		data->geometry.transparency = 1;
 	}
 }
+
+/* trail of the bob and phase portrait */
+
+void gl_toggle_trail (pendulum_configuration* data) {
+	trail.trail = !trail.trail;
+}
+
+void gl_toggle_phase (pendulum_configuration* data) {
+	trail.phase = !trail.phase;
+}
+
+/* empty the ring and fit the phase portrait to the energy of the initial angle */
+void gl_trail_reset (pendulum_configuration* data) {
+
+	trail.head = 0;
+	trail.count = 0;
+
+	// amplitude of the angular velocity when passing the lowest point
+	double velocity_max = sqrt( 2.0 * data->temp.moment_gravity_substitution / data->temp.moment_of_inertia *
+		(1.0 - cos(data->temp.angle)) );
+	if ( velocity_max <= 0.0 || !fm_finite(velocity_max) )
+		velocity_max = 1.0;
+
+	// lower left corner of the screen
+	const GLfloat size = 0.3f;
+	glUseProgram(gl_state.trail_program);
+	glUniform4f(gl_state.trail_unif_scale,
+		size / M_PI, size / velocity_max * gl_state.screen_width / gl_state.screen_height,
+		-1.0f + 1.2f * size, -1.0f + 1.2f * size * gl_state.screen_width / gl_state.screen_height);
+	glUseProgram(gl_state.program);
+	check();
+}
+
+/* append a state, only the new vertex is uploaded */
+void gl_trail_push (float angle, float velocity) {
+
+	// a diverged state would break the strip for the whole ring
+	if ( !fm_finite(angle) || !fm_finite(velocity) )
+		return;
+
+	if ( trail.count > 0 )
+		trail.head = (trail.head + 1) % PEN_GL_TRAIL_LENGTH;
+	if ( trail.count < PEN_GL_TRAIL_LENGTH )
+		trail.count++;
+
+	const GLfloat vertex[3] = { angle, velocity, (GLfloat) trail.head };
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl_state.trail_buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, trail.head * sizeof(vertex), sizeof(vertex), vertex);
+	if ( trail.head == 0 )
+		glBufferSubData(GL_ARRAY_BUFFER, PEN_GL_TRAIL_LENGTH * sizeof(vertex), sizeof(vertex), vertex);
+	glBindBuffer(GL_ARRAY_BUFFER, gl_state.buffers[0]);
+	check();
+}
+
+/* ensemble of pendulums drawn with a single call, angles are streamed every frame */
+
+int gl_ensemble_init (unsigned int count) {
+
+	CUBE_STATE_T* state = &gl_state;
+
+	if ( count == 0 || count > PEN_GL_ENSEMBLE_MAX ) {
+		fprintf(stderr, "ensemble size %u not supported (max %u)!\n\r", count, PEN_GL_ENSEMBLE_MAX);
+		return -1;
+	}
+
+	gl_ensemble_terminate();
+
+	// shaders are compiled once, buffers are resized on every init
+
+	if ( state->ensemble_program == 0 ) {
+		state->ensemble_program = load_program("gl_ensemble.vshader", "gl_ensemble.fshader",
+			&state->ensemble_vshader, &state->ensemble_fshader);
+
+		state->ensemble_attr_vertex = glGetAttribLocation(state->ensemble_program, "VertexPosition");
+		state->ensemble_attr_angle = glGetAttribLocation(state->ensemble_program, "Angle");
+		state->ensemble_attr_pose = glGetAttribLocation(state->ensemble_program, "Pose");
+		state->ensemble_attr_color = glGetAttribLocation(state->ensemble_program, "InstanceColor");
+		state->ensemble_unif_screenratio = glGetUniformLocation(state->ensemble_program, "ScreenRatio");
+		state->ensemble_unif_translation = glGetUniformLocation(state->ensemble_program, "Translation");
+		check();
+
+		glGenBuffers(4, state->ensemble_buffers);
+		check();
+	}
+
+	GenerateEnsembleGeometry(&ensemble.geometry, count);
+	ensemble.vertices_per_instance = ensemble.geometry.vertex_count / count;
+	ensemble.angles = calloc(ensemble.geometry.vertex_count, sizeof(GLfloat));
+	ensemble.instances = calloc(ensemble.geometry.vertex_count, sizeof(ensemble_instance));
+	if ( ensemble.angles == NULL || ensemble.instances == NULL ) {
+		fprintf(stderr, "cannot allocate ensemble!\n\r");
+		gl_ensemble_terminate();
+		return -1;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, ensemble.geometry.vertices_size, ensemble.geometry.vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->ensemble_buffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, ensemble.geometry.indices_size, ensemble.geometry.indices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[2]);
+	glBufferData(GL_ARRAY_BUFFER, ensemble.geometry.vertex_count * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, state->ensemble_buffers[3]);
+	glBufferData(GL_ARRAY_BUFFER, ensemble.geometry.vertex_count * sizeof(ensemble_instance), NULL, GL_DYNAMIC_DRAW);
+	check();
+
+	// the pendulum program and buffers stay bound outside of draw_ensemble
+
+	glBindBuffer(GL_ARRAY_BUFFER, state->buffers[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, state->buffers[1]);
+	check();
+
+	// uniforms follow the pendulum
+
+	GLfloat translation[4];
+	glGetUniformfv(state->program, state->unif_translation, translation);
+	glUseProgram(state->ensemble_program);
+	glUniform1f(state->ensemble_unif_screenratio, ((GLfloat) state->screen_width)/((GLfloat) state->screen_height));
+	glUniform4f(state->ensemble_unif_translation, translation[0], translation[1], 0.0f, 0.0f);
+	glUseProgram(state->program);
+	check();
+
+	ensemble.count = count;
+
+	unsigned int i;
+	for ( i = 0; i < count; i++ )
+		gl_ensemble_set_instance(i, 0.0f, 0.0f, pendulum_rodlen, 1.0f, 1.0f, 1.0f, 0.5f);
+
+	return 0;
+}
+
+void gl_ensemble_set_instance (unsigned int index, float pivot_x, float pivot_y, float rodlen,
+		float red, float green, float blue, float alpha) {
+
+	if ( index >= ensemble.count ) return;
+
+	ensemble_instance instance = { pivot_x, pivot_y, rodlen,
+		{ red * 255.0f, green * 255.0f, blue * 255.0f, alpha * 255.0f } };
+
+	unsigned int i;
+	ensemble_instance* vertex = ensemble.instances + index * ensemble.vertices_per_instance;
+	for ( i = 0; i < ensemble.vertices_per_instance; i++ )
+		vertex[i] = instance;
+
+	ensemble.instances_dirty = 1;
+}
+
+void gl_ensemble_update (const float* angles) {
+
+	unsigned int n, i;
+	GLfloat* vertex = ensemble.angles;
+	for ( n = 0; n < ensemble.count; n++ ) {
+		for ( i = 0; i < ensemble.vertices_per_instance; i++ )
+			*(vertex++) = angles[n];
+	}
+}
+
+void gl_ensemble_terminate () {
+
+	GeometryFree(&ensemble.geometry);
+	free(ensemble.angles);
+	free(ensemble.instances);
+	memset(&ensemble, 0, sizeof(ensemble));
+}
+
+/* set up (or remove) the links of the n-link model for the configuration */
+int gl_links_init (pendulum_configuration* data) {
+
+	if ( data->links.count == 0 ) {
+		if ( links_count > 0 )
+			gl_ensemble_terminate();
+		links_count = 0;
+		return 0;
+	}
+
+	if ( gl_ensemble_init(data->links.count) )
+		return -1;
+	links_count = data->links.count;
+	band = 0;
+
+	gl_links_update(data, NULL);
+	return 0;
+}
+
+/* angles: solver state (relative joint angles), NULL for the initial angles */
+void gl_links_update (pendulum_configuration* data, const double* angles) {
+
+	if ( links_count == 0 )
+		return;
+
+	float absolute[PAR_LINKS_MAX];
+	float x = 0.0f, y = 0.0f, angle = 0.0f;
+	unsigned int i;
+	for ( i = 0; i < links_count; i++ ) {
+		if ( angles != NULL )
+			angle += angles[i];
+		else
+			angle += i == 0 ? data->temp.angle : data->links.initial_angle[i];
+		absolute[i] = angle;
+
+		// pivots are chained, link lengths on the scale of the screen
+		const float length = data->links.length[i] / data->geometry.screen_width * 2.0f;
+		gl_ensemble_set_instance(i, x, y, length, 0.96f, 0.686f, 0.1176f, 1.0f);
+		x += length * sinf(angle);
+		y -= length * cosf(angle);
+	}
+
+	gl_ensemble_update(absolute);
+}
+
+/* set up (or remove) the fan of the uncertainty band, after gl_links_init */
+int gl_band_init (pendulum_configuration* data) {
+
+	if ( !data->uncertainty.enabled || links_count > 0 ) {
+		if ( band )
+			gl_ensemble_terminate();
+		band = 0;
+		return 0;
+	}
+
+	if ( gl_ensemble_init(PEN_GL_BAND_FAN) )
+		return -1;
+	band = 1;
+
+	band_instances();
+	gl_band_update(data->temp.angle, 0.0f);
+	return 0;
+}
+
+/* fan from mean - sigma to mean + sigma (rad) */
+void gl_band_update (float mean, float sigma) {
+
+	if ( !band )
+		return;
+
+	float angles[PEN_GL_BAND_FAN];
+	unsigned int i;
+	for ( i = 0; i < PEN_GL_BAND_FAN; i++ )
+		angles[i] = mean + sigma * (2.0f * i / (PEN_GL_BAND_FAN - 1) - 1.0f);
+
+	gl_ensemble_update(angles);
+}
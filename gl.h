@@ -16,10 +16,30 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <time.h>
 #include "par.h"
 
 void gl_draw_frame (float angle);
+double gl_vblank_measure (float angle);
+int gl_vblank_before (double lead, struct timespec* when);
 int gl_init ();
+int gl_init_offscreen (unsigned int width, unsigned int height);
+void gl_read_frame (void* pixels);
 int gl_terminate ();
+void gl_reset (pendulum_configuration* data);
+void gl_blank ();
 int gl_update_geometry (float rodlen_delta, float x_delta, float y_delta, pendulum_configuration* data);
 void gl_toggle_alpha (pendulum_configuration* data);
+void gl_toggle_trail (pendulum_configuration* data);
+void gl_toggle_phase (pendulum_configuration* data);
+void gl_trail_reset (pendulum_configuration* data);
+void gl_trail_push (float angle, float velocity);
+int gl_ensemble_init (unsigned int count);
+void gl_ensemble_set_instance (unsigned int index, float pivot_x, float pivot_y, float rodlen,
+	float red, float green, float blue, float alpha);
+void gl_ensemble_update (const float* angles);
+void gl_ensemble_terminate ();
+int gl_links_init (pendulum_configuration* data);
+void gl_links_update (pendulum_configuration* data, const double* angles);
+int gl_band_init (pendulum_configuration* data);
+void gl_band_update (float mean, float sigma);
@@ -23,67 +23,27 @@
 
 #include "gl_geometries.h"
 
-#define PEN_GL_ROD_WIDTH	0.008f
-#define PEN_GL_BOB_RADIUS	0.035f
 #define PEN_GL_ROD_LENGTH	1.0f		// will be replaced on config load
+#define PEN_GL_ENSEMBLE_ROD_WIDTH	0.004f
+#define PEN_GL_ENSEMBLE_BOB_RADIUS	0.02f
+#define PEN_GL_ENSEMBLE_BOB_SEGMENTS	8
 #define PI 3.1415926535897932384626433832795f
 
+/*
+ * the pendulum is a single quad around rod and bob, the shape itself is
+ * evaluated per fragment from a signed distance (see gl_pendulum.fshader)
+ */
 void GeneratePendulumGeometry (geometry_data* geometry) {
 
-	// geometry parameters
-
-	unsigned int rod_numelements = 2;
-	unsigned int rod_numvertices = 4;
-	unsigned int bob_numelements = 64;
-	unsigned int bob_numvertices = bob_numelements + 1;
-
-	// generate rod geometry
-
-	float rod_vertices[4][6] = {	{0.0f - PEN_GL_ROD_WIDTH ,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
-					{0.0f + PEN_GL_ROD_WIDTH ,  0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
-					{0.0f - PEN_GL_ROD_WIDTH , -PEN_GL_ROD_LENGTH, 0.0f, 0.0f, 0.0f, 0.0f},
-					{0.0f + PEN_GL_ROD_WIDTH , -PEN_GL_ROD_LENGTH, 0.0f, 0.0f, 0.0f, 0.0f},	};
-	unsigned short rod_indices[6] = {0,2,1,   1,2,3};
+	const float halfwidth = PEN_GL_BOB_RADIUS + PEN_GL_MARGIN;
+	const float bottom = -(PEN_GL_ROD_LENGTH + PEN_GL_BOB_RADIUS + PEN_GL_MARGIN);
+	const float top = PEN_GL_ROD_WIDTH + PEN_GL_MARGIN;
 
-	// generate bob geometry (combined array)
-	
-	float pen_vertices[bob_numvertices + rod_numvertices][6];
-	unsigned short pen_indices[bob_numelements*3 + 6];
-	
-	unsigned int i, j;
-	for ( i = 0; i < rod_numvertices; i++ )
-	{
-		for ( j = 0; j < rod_numelements*3; j++ )
-			pen_vertices[i][j] = rod_vertices[i][j];
-	}
-	for ( i = 0; i < rod_numelements*3; i++ )
-	{
-		pen_indices[i] = rod_indices[i];
-	}
-
-	pen_vertices[rod_numvertices][0] = 0.0f; pen_vertices[rod_numvertices][1] = -PEN_GL_ROD_LENGTH;
-	pen_vertices[rod_numvertices][2] = 0.0f; pen_vertices[rod_numvertices][3] = 0.0f;
-	pen_vertices[rod_numvertices][4] = 0.0f; pen_vertices[rod_numvertices][5] = 0.0f;
-	float angleStep = (2.0f * PI) / ((float) bob_numelements);
-	for ( i = 1; i < bob_numvertices; i++ )
-	{
-		pen_vertices[rod_numvertices + i][0] = 0.0f + PEN_GL_BOB_RADIUS * cosf(angleStep * (float)i);
-		pen_vertices[rod_numvertices + i][1] = -PEN_GL_ROD_LENGTH + PEN_GL_BOB_RADIUS * sinf(angleStep * (float)i);
-		pen_vertices[rod_numvertices + i][2] = 0.0f;
-		pen_vertices[rod_numvertices + i][3] = pen_vertices[rod_numvertices + i][0];
-		pen_vertices[rod_numvertices + i][4] = pen_vertices[rod_numvertices + i][1] + PEN_GL_ROD_LENGTH;
-		pen_vertices[rod_numvertices + i][5] = 0.0f;
-	}
-
-	pen_indices[3*rod_numelements + 0] = rod_numvertices + 0;
-	pen_indices[3*rod_numelements + 1] = rod_numvertices + bob_numvertices-1;
-	pen_indices[3*rod_numelements + 2] = rod_numvertices + 1;
-	for ( i = 1; i < bob_numelements; i++ )
-	{
-		pen_indices[3*rod_numelements + i*3+0] = rod_numvertices + 0;
-		pen_indices[3*rod_numelements + i*3+1] = rod_numvertices + i;
-		pen_indices[3*rod_numelements + i*3+2] = rod_numvertices + i+1;
-	}
+	float pen_vertices[4][6] = {	{-halfwidth, top,    0.0f, 0.0f, 0.0f, 0.0f},
+					{+halfwidth, top,    0.0f, 0.0f, 0.0f, 0.0f},
+					{-halfwidth, bottom, 0.0f, 0.0f, 0.0f, 0.0f},
+					{+halfwidth, bottom, 0.0f, 0.0f, 0.0f, 0.0f},	};
+	unsigned short pen_indices[6] = {0,2,1,   1,2,3};
 
 	// initialize geometry data container
 
@@ -91,11 +51,11 @@ void GeneratePendulumGeometry (geometry_data* geometry) {
 	geometry->vertex_offset = 0;
 	geometry->normal_offset = 3 * sizeof(float);
 
-	geometry->vertex_count = rod_numvertices + bob_numvertices;
-	geometry->vertices_size = geometry->stride * geometry->vertex_count;
+	geometry->vertex_count = 4;
+	geometry->vertices_size = sizeof(pen_vertices);
 	geometry->vertices = malloc(geometry->vertices_size);
 	
-	geometry->element_count = (bob_numelements + rod_numelements);
+	geometry->element_count = 2;
 	geometry->indices_size = sizeof(pen_indices);
 	geometry->indices = malloc(geometry->indices_size);
 
@@ -113,11 +73,67 @@ void GeometryUpdatePendulum (geometry_data* geometry, float rodlen) {
 	if ( rodlen < 0.0f ) return;
 
 	// rodlen is a positive value, but the tip of the pendulum points downwards
-	float rodlen_delta = -geometry->vertices[2*6+1] - rodlen;
+	geometry->vertices[2*6+1] = -(rodlen + PEN_GL_BOB_RADIUS + PEN_GL_MARGIN);
+	geometry->vertices[3*6+1] = -(rodlen + PEN_GL_BOB_RADIUS + PEN_GL_MARGIN);
+}
+
+/*
+ * ensemble geometry: "count" copies of a coarse pendulum in one buffer
+ * vertex layout is (x, y, anchor), anchor = 1 moves the vertex down by the
+ * rod length of the instance in the vertex shader, so the rod length is no
+ * part of the geometry and the buffer never has to be uploaded again
+ */
+void GenerateEnsembleGeometry (geometry_data* geometry, unsigned int count) {
+
+	const unsigned int numvertices = 4 + PEN_GL_ENSEMBLE_BOB_SEGMENTS + 1;
+	const unsigned int numelements = 2 + PEN_GL_ENSEMBLE_BOB_SEGMENTS;
+
+	geometry->stride = 3 * sizeof(float);
+	geometry->vertex_offset = 0;
+	geometry->normal_offset = 0;
 
-	int i;
-	for (i = 2; i < geometry->vertex_count ; i++) {
-		geometry->vertices[i*6+1] += rodlen_delta;
+	geometry->vertex_count = count * numvertices;
+	geometry->vertices_size = geometry->stride * geometry->vertex_count;
+	geometry->vertices = malloc(geometry->vertices_size);
+
+	geometry->element_count = count * numelements;
+	geometry->indices_size = geometry->element_count * 3 * sizeof(unsigned short);
+	geometry->indices = malloc(geometry->indices_size);
+
+	const float angleStep = (2.0f * PI) / ((float) PEN_GL_ENSEMBLE_BOB_SEGMENTS);
+
+	unsigned int n, i;
+	for ( n = 0; n < count; n++ )
+	{
+		float* v = geometry->vertices + n * numvertices * 3;
+		unsigned short* e = geometry->indices + n * numelements * 3;
+		const unsigned short base = n * numvertices;
+
+		// rod, top vertices fixed at the pivot, bottom vertices at the bob
+
+		v[0] = -PEN_GL_ENSEMBLE_ROD_WIDTH; v[1] = 0.0f; v[2] = 0.0f;
+		v[3] = +PEN_GL_ENSEMBLE_ROD_WIDTH; v[4] = 0.0f; v[5] = 0.0f;
+		v[6] = -PEN_GL_ENSEMBLE_ROD_WIDTH; v[7] = 0.0f; v[8] = 1.0f;
+		v[9] = +PEN_GL_ENSEMBLE_ROD_WIDTH; v[10] = 0.0f; v[11] = 1.0f;
+
+		e[0] = base + 0; e[1] = base + 2; e[2] = base + 1;
+		e[3] = base + 1; e[4] = base + 2; e[5] = base + 3;
+
+		// bob as triangle fan around its center
+
+		v[12] = 0.0f; v[13] = 0.0f; v[14] = 1.0f;
+		for ( i = 1; i <= PEN_GL_ENSEMBLE_BOB_SEGMENTS; i++ )
+		{
+			v[12 + i*3 + 0] = PEN_GL_ENSEMBLE_BOB_RADIUS * cosf(angleStep * (float)i);
+			v[12 + i*3 + 1] = PEN_GL_ENSEMBLE_BOB_RADIUS * sinf(angleStep * (float)i);
+			v[12 + i*3 + 2] = 1.0f;
+		}
+
+		for ( i = 0; i < PEN_GL_ENSEMBLE_BOB_SEGMENTS; i++ )
+		{
+			e[6 + i*3 + 0] = base + 4;
+			e[6 + i*3 + 1] = base + 4 + 1 + i;
+			e[6 + i*3 + 2] = base + 4 + 1 + (i + 1) % PEN_GL_ENSEMBLE_BOB_SEGMENTS;
+		}
 	}
 }
-
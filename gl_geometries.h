@@ -16,6 +16,10 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define PEN_GL_ROD_WIDTH	0.008f		// half width
+#define PEN_GL_BOB_RADIUS	0.035f
+#define PEN_GL_MARGIN		0.005f		// room for the antialiased edge
+
 typedef struct {
 	unsigned int element_count;
 	unsigned int vertex_count;
@@ -33,3 +37,4 @@ typedef struct {
 void GeometryFree (geometry_data* geometry);
 void GeneratePendulumGeometry (geometry_data* geometry);
 void GeometryUpdatePendulum (geometry_data* geometry, float rodlen);
+void GenerateEnsembleGeometry (geometry_data* geometry, unsigned int count);
@@ -41,10 +41,6 @@ void init_ogl_ng (CUBE_STATE_T *state) {
 		EGL_BLUE_SIZE, 8,
 		EGL_ALPHA_SIZE, 8,
 		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-		EGL_DEPTH_SIZE, 8,
-		EGL_STENCIL_SIZE, 4,
-		EGL_SAMPLE_BUFFERS, 1,
-		EGL_SAMPLES, 4,
 		EGL_NONE
 	};
 
@@ -119,11 +115,71 @@ void init_ogl_ng (CUBE_STATE_T *state) {
 
 	// Set background color and clear buffers
 	glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	glClear( GL_COLOR_BUFFER_BIT );
 
 	check();
 }
 
+int init_ogl_pbuffer (CUBE_STATE_T *state, uint32_t width, uint32_t height) {
+
+	EGLint num_config;
+	EGLConfig config;
+
+	static const EGLint attribute_list[] = {
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE
+	};
+
+	static const EGLint context_attributes[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+
+	const EGLint surface_attributes[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+
+	state->screen_width = width;
+	state->screen_height = height;
+
+	state->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if ( state->display == EGL_NO_DISPLAY )
+		return -1;
+
+	if ( eglInitialize(state->display, NULL, NULL) == EGL_FALSE )
+		return -1;
+
+	if ( eglChooseConfig(state->display, attribute_list, &config, 1, &num_config) == EGL_FALSE || num_config < 1 )
+		return -1;
+
+	if ( eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE )
+		return -1;
+
+	state->context = eglCreateContext(state->display, config, EGL_NO_CONTEXT, context_attributes);
+	if ( state->context == EGL_NO_CONTEXT )
+		return -1;
+
+	state->surface = eglCreatePbufferSurface(state->display, config, surface_attributes);
+	if ( state->surface == EGL_NO_SURFACE )
+		return -1;
+
+	if ( eglMakeCurrent(state->display, state->surface, state->surface, state->context) == EGL_FALSE )
+		return -1;
+
+	glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
+	glClear( GL_COLOR_BUFFER_BIT );
+	check();
+
+	return 0;
+}
+
 char* read_file (const char* filename) {
 
 	FILE *filepointer;
@@ -44,9 +44,48 @@ typedef struct {
 	GLuint unif_screenratio;
 	GLuint unif_rotation;
 	GLuint unif_translation;
+	GLuint unif_rodlength;
+	GLuint unif_shape;
+	GLuint unif_pixelsize;
+
+	/* vertex and index buffer of the pendulum */
+
+	GLuint buffers[2];
+
+	/* batched ensemble of pendulums, see gl_ensemble_init */
+
+	GLuint ensemble_program;
+	GLuint ensemble_vshader;
+	GLuint ensemble_fshader;
+	GLuint ensemble_buffers[4]; /* geometry, indices, angles (stream), instances */
+
+	GLuint ensemble_attr_vertex;
+	GLuint ensemble_attr_angle;
+	GLuint ensemble_attr_pose;
+	GLuint ensemble_attr_color;
+	GLuint ensemble_unif_screenratio;
+	GLuint ensemble_unif_translation;
+
+	/* trail and phase portrait from a ring of recent states, see gl_trail_push */
+
+	GLuint trail_program;
+	GLuint trail_vshader;
+	GLuint trail_fshader;
+	GLuint trail_buffer;
+
+	GLuint trail_attr_state;
+	GLuint trail_unif_screenratio;
+	GLuint trail_unif_translation;
+	GLuint trail_unif_rodlength;
+	GLuint trail_unif_head;
+	GLuint trail_unif_length;
+	GLuint trail_unif_mode;
+	GLuint trail_unif_scale;
+	GLuint trail_unif_color;
 } CUBE_STATE_T;
 
 #define check() assert(glGetError() == 0)
 
 void init_ogl_ng (CUBE_STATE_T *state);
+int init_ogl_pbuffer (CUBE_STATE_T *state, uint32_t width, uint32_t height);
 char* read_file (const char* filename);
@@ -17,13 +17,29 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include "hw.h"
 
+/* usage: hw-test [sysfs|gpiod|mock [device [line]]] */
 int main (int argc, char *argv[]) {
 
+	int backend = HW_GPIO_SYSFS;
+	if ( argc > 1 && strcmp(argv[1], "gpiod") == 0 )
+		backend = HW_GPIO_GPIOD;
+	else if ( argc > 1 && strcmp(argv[1], "mock") == 0 )
+		backend = HW_GPIO_MOCK;
+	const char* device = argc > 2 ? argv[2] : "";
+	const unsigned int line = argc > 3 ? atoi(argv[3]) : HW_GPIO_LINE;
+
+	if ( hw_init(backend, device, line) ) {
+		fprintf(stderr, "error opening gpio!\n");
+		return(1);
+	}
+
 	while (1 == 1) {
-		printf("turning on GPIO 17\n");
+		printf("turning on GPIO %u\n", line);
 		if ( -1 == hw_magnet_acquire() ) {
 			fprintf(stderr, "error turning on!\n");
 			return(1);
@@ -31,11 +47,12 @@ int main (int argc, char *argv[]) {
 
 		usleep(1000 * 1000);
 
-		printf("turning off GPIO 17\n");
-		if ( -1 == hw_magnet_release() ) {
+		struct timespec edge;
+		if ( -1 == hw_magnet_release(&edge) ) {
 			fprintf(stderr, "error turning off!\n");
 			return(1);
 		}
+		printf("turned off GPIO %u at %ld.%09ld\n", line, (long) edge.tv_sec, edge.tv_nsec);
 
 		usleep(1000 * 1000);
 	}
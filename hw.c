@@ -18,64 +18,209 @@
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#ifdef HW_GPIOD
+#include <gpiod.h>
+#endif
 #include "hw.h"
 
+/*
+ * the gpio stays open for the whole session (see hw_init), switching the
+ * magnet is a single syscall: pwrite on the sysfs/mock file or the line
+ * ioctl of libgpiod
+ */
+static struct {
+	int backend;
+	unsigned int line;
+	char device[256];
+	int fd; // sysfs and mock
+#ifdef HW_GPIOD
+	struct gpiod_chip* chip;
+	struct gpiod_line* request;
+#endif
+} gpio = { HW_GPIO_SYSFS, HW_GPIO_LINE, "", -1 };
+
 int hw_magnet_check () {
 
+	if ( gpio.backend != HW_GPIO_SYSFS )
+		return(0);
+
+	char path[256];
+	snprintf(path, sizeof(path), HW_SYSFS_PATH, gpio.line, "direction");
+
 	char string[3];
 	int fd;
-	fd = open("/sys/class/gpio/gpio17/direction", O_RDONLY);
+	fd = open(path, O_RDONLY);
 	if ( -1 == fd ) {
 		fprintf(stderr, "Failed to open gpio DIRECTION for testing!\n");
 		return(-1);
 	}
 
-	if ( -1 == read(fd, string, 3) ) {
+	if ( 3 != read(fd, string, 3) ) {
 		fprintf(stderr, "Failed to read gpio DIRECTION for testing!\n");
+		close(fd);
 		return(-1);
 	}
 
-	if ( 0 != strcmp (string, "out") ) {
+	close(fd);
+
+	if ( 0 != strncmp (string, "out", 3) ) {
 		fprintf(stderr, "Gpio DIRECTION is not set to OUT!\n");
 		return(-1);
 	}
 
-	close(fd);
-	
 	return(0);
 }
 
-int gpio_write (int value) {
+static int gpio_open () {
+
+	if ( gpio.backend == HW_GPIO_GPIOD ) {
+#ifdef HW_GPIOD
+		if ( gpio.request != NULL )
+			return(0);
+
+		gpio.chip = gpiod_chip_open_lookup(gpio.device[0] ? gpio.device : HW_GPIO_CHIP);
+		if ( gpio.chip == NULL ) {
+			fprintf(stderr, "Failed to open gpio chip!\n");
+			return(-1);
+		}
+
+		gpio.request = gpiod_chip_get_line(gpio.chip, gpio.line);
+		if ( gpio.request == NULL || gpiod_line_request_output(gpio.request, "pendulum", 0) ) {
+			fprintf(stderr, "Failed to request gpio line %u for output!\n", gpio.line);
+			gpiod_chip_close(gpio.chip);
+			gpio.chip = NULL;
+			gpio.request = NULL;
+			return(-1);
+		}
+
+		return(0);
+#else
+		fprintf(stderr, "gpio backend gpiod not compiled in (make GPIOD=1)!\n");
+		return(-1);
+#endif
+	}
 
-	static const char s_values_str[] = "01";
+	if ( gpio.fd != -1 )
+		return(0);
 
-	int fd;
+	char path[256];
+	if ( gpio.backend == HW_GPIO_MOCK )
+		snprintf(path, sizeof(path), "%s", gpio.device);
+	else
+		snprintf(path, sizeof(path), HW_SYSFS_PATH, gpio.line, "value");
 
-	fd = open(GPIO_PATH, O_WRONLY);
-	if ( -1 == fd ) {
+	gpio.fd = open(path, gpio.backend == HW_GPIO_MOCK ? O_WRONLY | O_CREAT : O_WRONLY, 0644);
+	if ( -1 == gpio.fd ) {
 		fprintf(stderr, "Failed to open gpio VALUE for writing!\n");
 		return(-1);
 	}
 
-	if ( 1 != write(fd, &s_values_str[0 == value ? 0 : 1], 1) ) {
-		fprintf(stderr, "Failed to write value!\n");
+	return(0);
+}
+
+static int gpio_write (int value) {
+
+	static const char s_values_str[] = "01";
+
+	if ( gpio_open() )
 		return(-1);
+
+#ifdef HW_GPIOD
+	if ( gpio.backend == HW_GPIO_GPIOD ) {
+		if ( gpiod_line_set_value(gpio.request, 0 == value ? 0 : 1) ) {
+			fprintf(stderr, "Failed to write value!\n");
+			return(-1);
+		}
+		return(0);
 	}
+#endif
 
-	close(fd);
+	if ( 1 != pwrite(gpio.fd, &s_values_str[0 == value ? 0 : 1], 1, 0) ) {
+		fprintf(stderr, "Failed to write value!\n");
+		return(-1);
+	}
 
 	return(0);
 }
 
-inline int hw_magnet_acquire () {
+/* backend: HW_GPIO_*, device: gpio chip (gpiod) or file (mock), line: gpio number */
+int hw_init (int backend, const char* device, unsigned int line) {
+
+	hw_terminate();
+
+	gpio.backend = backend;
+	gpio.line = line;
+	snprintf(gpio.device, sizeof(gpio.device), "%s", device ? device : "");
+
+	if ( hw_magnet_check() )
+		return(-1);
+
+	return gpio_open();
+}
+
+void hw_terminate () {
+
+	if ( gpio.fd != -1 )
+		close(gpio.fd);
+	gpio.fd = -1;
+
+#ifdef HW_GPIOD
+	if ( gpio.request != NULL )
+		gpiod_line_release(gpio.request);
+	if ( gpio.chip != NULL )
+		gpiod_chip_close(gpio.chip);
+	gpio.request = NULL;
+	gpio.chip = NULL;
+#endif
+}
+
+int hw_magnet_acquire () {
 
 	return gpio_write(1);
 }
 
-inline int hw_magnet_release () {
+/* edge (optional): time of the release, middle of the write call (CLOCK_MONOTONIC) */
+int hw_magnet_release (struct timespec* edge) {
+
+	struct timespec before, after;
+
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	const int err = gpio_write(0);
+	clock_gettime(CLOCK_MONOTONIC, &after);
 
-	return gpio_write(0);
+	if ( edge != NULL ) {
+		const long nsec = ( (after.tv_sec - before.tv_sec) * 1000000000L + (after.tv_nsec - before.tv_nsec) ) / 2;
+		edge->tv_sec = before.tv_sec;
+		edge->tv_nsec = before.tv_nsec + nsec;
+		while ( edge->tv_nsec >= 1000000000L ) {
+			edge->tv_nsec -= 1000000000L;
+			edge->tv_sec++;
+		}
+	}
+
+	return err;
 }
 
+/* release at a given time (CLOCK_MONOTONIC): sleep until shortly before, then busy wait */
+int hw_magnet_release_at (const struct timespec* when, struct timespec* edge) {
+
+	struct timespec wakeup = *when;
+	wakeup.tv_nsec -= HW_SPIN_NSEC;
+	if ( wakeup.tv_nsec < 0 ) {
+		wakeup.tv_nsec += 1000000000L;
+		wakeup.tv_sec--;
+	}
+
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) == EINTR );
+
+	struct timespec now;
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ( now.tv_sec < when->tv_sec || (now.tv_sec == when->tv_sec && now.tv_nsec < when->tv_nsec) );
+
+	return hw_magnet_release(edge);
+}
@@ -16,11 +16,26 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-// #define GPIO_PATH "/sys/devices/virtual/gpio/gpio17/value"
-#define GPIO_PATH "/sys/class/gpio/gpio17/value"
+#ifndef PEN_HW
+#define PEN_HW
 
-int gpio_write (int value);
+#include <time.h>
+
+/* gpio backends, see hw_init */
+#define HW_GPIO_SYSFS	0	// /sys/class/gpio/gpio<line>/value, kept open
+#define HW_GPIO_GPIOD	1	// gpio character device via libgpiod (build with GPIOD=1)
+#define HW_GPIO_MOCK	2	// plain file receiving "0"/"1", for testing without a rig
+
+#define HW_SYSFS_PATH "/sys/class/gpio/gpio%u/%s"
+#define HW_GPIO_LINE 17
+#define HW_GPIO_CHIP "gpiochip0"
+#define HW_SPIN_NSEC 300000 // busy wait before a scheduled release, see hw_magnet_release_at
+
+int hw_init (int backend, const char* device, unsigned int line);
+void hw_terminate ();
 int hw_magnet_check ();
 int hw_magnet_acquire ();
-int hw_magnet_release ();
+int hw_magnet_release (struct timespec* edge);
+int hw_magnet_release_at (const struct timespec* when, struct timespec* edge);
 
+#endif
@@ -0,0 +1,218 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "lya.h"
+#include "fm.h"
+#include "sol.h"
+#include "pen.h"
+#include "ev.h"
+
+#define LYA_STEP 1.0e-3 // s, fixed runge-kutta step of a scan
+#define LYA_RENORMALIZE 100 // steps between renormalisations
+#define LYA_TRANSIENT 0.1 // part of the duration before the exponents are accumulated
+#define LYA_VALUES_MAX 4096
+#define LYA_THREADS_MAX 64
+
+/*
+ * lyapunov exponents of the single pendulum (benettin et al.)
+ *
+ * two tangent vectors are integrated with the state (see rhs_tangent) and
+ * stay orthonormal by a gram-schmidt (qr) decomposition from time to time,
+ * the logarithms of the diagonal of r grow with the exponents, so their
+ * sums divided by the time converge to the largest and the second exponent
+ *
+ * during a run the solver renormalises after every frame (streaming
+ * estimate in temp.lyapunov, see sol_solve_next_frame), a scan integrates
+ * one trajectory per value of a parameter in parallel
+ */
+
+/* parameter scan */
+
+typedef enum {
+	LYA_DRIVE_AMPLITUDE,
+	LYA_DRIVE_FREQUENCY,
+	LYA_FRICTION_LINEAR,
+	LYA_INITIAL_ANGLE
+} lya_parameter;
+
+static const char* parameter_names[] = {
+	"drive_amplitude", "drive_frequency", "friction_linear", "initial_angle"
+};
+
+static struct {
+	const pendulum_configuration* conf;
+	lya_parameter parameter;
+	double from, to;
+	unsigned int steps;
+	double duration;
+	double (*result)[2];
+	atomic_uint next;
+} scan;
+
+static inline double value_of (unsigned int i) {
+	return scan.steps > 1 ? scan.from + (scan.to - scan.from) * i / (scan.steps - 1) : scan.from;
+}
+
+static void set_parameter (pendulum_configuration* conf, double value) {
+
+	switch ( scan.parameter ) {
+		case LYA_DRIVE_AMPLITUDE:
+			conf->drive.amplitude = value;
+			break;
+		case LYA_DRIVE_FREQUENCY:
+			conf->drive.frequency = value;
+			conf->drive.omega = 2.0 * M_PI * value;
+			break;
+		case LYA_FRICTION_LINEAR:
+			conf->bearing.friction_linear = value;
+			break;
+		case LYA_INITIAL_ANGLE:
+			conf->model.initial_angle = value;
+			break;
+	}
+}
+
+static void exponents (pendulum_configuration* conf, double result[2]) {
+
+	// a copy of the configuration per thread, the systems have to point to it
+	conf->model.base.params = conf;
+	const gsl_odeiv2_system system = { rhs_tangent, NULL, 2 + 4, conf };
+
+	double state[2 + 4] = { conf->model.initial_angle, 0.0 };
+	double t = 0.0;
+
+	const unsigned int total = (unsigned int) ceil(scan.duration / (LYA_STEP * LYA_RENORMALIZE));
+	const unsigned int transient = (unsigned int) (LYA_TRANSIENT * total);
+	unsigned int n;
+
+	sol_lyapunov_init(conf, state + 2);
+	for ( n = 0; n < total; n++ ) {
+		sol_rk4_fixed(&system, &t, state, LYA_STEP, LYA_RENORMALIZE);
+		// a diverged state or a blown up tangent vector has no exponents
+		unsigned int i;
+		for ( i = 0; i < 2 + 4 && fm_finite(state[i]); i++ );
+		if ( i < 2 + 4 ) {
+			result[0] = result[1] = NAN;
+			return;
+		}
+
+		// the transient (not yet on the attractor) is discarded
+		if ( n == transient )
+			conf->temp.lyapunov_sum[0] = conf->temp.lyapunov_sum[1] = 0.0;
+		sol_lyapunov_renormalize(conf, state + 2, t - transient * LYA_STEP * LYA_RENORMALIZE);
+	}
+
+	result[0] = conf->temp.lyapunov[0];
+	result[1] = conf->temp.lyapunov[1];
+}
+
+static void* worker (void* argument) {
+
+	pendulum_configuration conf;
+
+	unsigned int i;
+	while ( (i = atomic_fetch_add(&scan.next, 1)) < scan.steps && !stopflag ) {
+		memcpy(&conf, scan.conf, sizeof(pendulum_configuration));
+		set_parameter(&conf, value_of(i));
+		exponents(&conf, scan.result[i]);
+	}
+
+	return NULL;
+}
+
+/* exponents over a range of a parameter: "parameter:from:to:steps", printed as "value l1 l2" */
+int lya_scan (pendulum_configuration* conf, const char* specification, double duration) {
+
+	if ( conf->links.count > 0 || conf->model.base.jacobian == NULL ) {
+		fprintf(stderr, "lyapunov exponents need a single pendulum!\n\r");
+		return -1;
+	}
+
+	char name[64];
+	memset(&scan, 0, sizeof(scan));
+	if ( sscanf(specification, "%63[^:]:%lf:%lf:%u", name, &scan.from, &scan.to, &scan.steps) != 4 ||
+			scan.steps == 0 || scan.steps > LYA_VALUES_MAX ) {
+		fprintf(stderr, "scan needs parameter:from:to:steps (at most %u steps)!\n\r", LYA_VALUES_MAX);
+		return -1;
+	}
+
+	unsigned int i;
+	for ( i = 0; i < sizeof(parameter_names) / sizeof(parameter_names[0]); i++ )
+		if ( strcmp(name, parameter_names[i]) == 0 )
+			break;
+	if ( i == sizeof(parameter_names) / sizeof(parameter_names[0]) ) {
+		fprintf(stderr, "unknown scan parameter %s!\n\r", name);
+		return -1;
+	}
+
+	if ( duration < 10.0 * LYA_STEP * LYA_RENORMALIZE ) {
+		fprintf(stderr, "scan duration too short!\n\r");
+		return -1;
+	}
+
+	scan.conf = conf;
+	scan.parameter = i;
+	scan.duration = duration;
+	atomic_init(&scan.next, 0);
+	scan.result = calloc(scan.steps, sizeof(*scan.result));
+	if ( scan.result == NULL ) {
+		fprintf(stderr, "cannot allocate scan!\n\r");
+		return -1;
+	}
+
+	// one thread per core
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if ( cores < 1 ) cores = 1;
+	if ( cores > LYA_THREADS_MAX ) cores = LYA_THREADS_MAX;
+
+	pthread_t threads[LYA_THREADS_MAX];
+	long started = 0;
+	for ( i = 0; i < cores; i++ )
+		if ( pthread_create(&threads[started], NULL, worker, NULL) == 0 )
+			started++;
+	if ( started == 0 )
+		worker(NULL);
+
+	// signals are only seen by the event loop
+	while ( atomic_load(&scan.next) < scan.steps && !stopflag )
+		ev_wait(200);
+
+	for ( i = 0; i < started; i++ )
+		pthread_join(threads[i], NULL);
+
+	if ( !stopflag ) {
+		printf("# %s lambda1 lambda2 (1/s, %.0f s)\n", parameter_names[scan.parameter], duration);
+		for ( i = 0; i < scan.steps; i++ ) {
+			printf("%g %g %g\n", value_of(i), scan.result[i][0], scan.result[i][1]);
+		}
+	}
+
+	free(scan.result);
+
+	return stopflag ? -1 : 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "map.h"
+#include "fm.h"
+#include "sol.h"
+#include "pen.h"
+#include "ev.h"
+
+#define MAP_TRANSIENT 64 // drive periods until the trajectory is on its attractor
+#define MAP_RECORD 16 // drive periods classified and recorded
+#define MAP_STEPS 64 // fixed runge-kutta steps per drive period
+#define MAP_THREADS_MAX 64
+
+/*
+ * basin of attraction and poincare section of the driven pendulum
+ *
+ * every pixel of the map is an initial condition, angle from -pi to pi
+ * (x) and velocity within twice the natural frequency (y, up), each one is
+ * integrated with fixed steps for MAP_TRANSIENT drive periods and then
+ * followed for MAP_RECORD periods: the net rotation and the stroboscopic
+ * angle give its class in the basin map (8 bit, pgm), the stroboscopic
+ * states (once per drive period) are set in the section (1 bit, pbm)
+ *
+ * rows are handed out to one thread per core, the solver only reads the
+ * configuration (see sol_rk4_fixed)
+ */
+static struct {
+	pendulum_configuration* conf;
+	unsigned int width, height;
+	double velocity_max;
+	unsigned char* basin;
+	atomic_uchar* section;
+	unsigned int section_stride;
+	atomic_uint next_row;
+} map;
+
+static inline double wrap (double angle) {
+	return angle - 2.0 * M_PI * floor((angle + M_PI) / (2.0 * M_PI));
+}
+
+static inline void section_set (double angle, double velocity) {
+
+	const double x = (wrap(angle) + M_PI) / (2.0 * M_PI) * map.width;
+	const double y = (map.velocity_max - velocity) / (2.0 * map.velocity_max) * map.height;
+	if ( x < 0.0 || x >= map.width || y < 0.0 || y >= map.height )
+		return;
+
+	const unsigned int column = (unsigned int) x, row = (unsigned int) y;
+	atomic_fetch_or_explicit(&map.section[row * map.section_stride + column / 8],
+		(unsigned char) (0x80 >> (column % 8)), memory_order_relaxed);
+}
+
+static unsigned char classify (double angle, double velocity) {
+
+	const gsl_odeiv2_system* system = &map.conf->model.base;
+	const double period = 2.0 * M_PI / map.conf->drive.omega;
+	const double h = period / MAP_STEPS;
+
+	double state[2] = { angle, velocity };
+	double t = 0.0;
+	unsigned int n;
+
+	for ( n = 0; n < MAP_TRANSIENT; n++ )
+		sol_rk4_fixed(system, &t, state, h, MAP_STEPS);
+
+	const double start = state[0];
+	for ( n = 0; n < MAP_RECORD; n++ ) {
+		sol_rk4_fixed(system, &t, state, h, MAP_STEPS);
+		if ( !fm_finite(state[0]) || !fm_finite(state[1]) )
+			return MAP_FAILED;
+		if ( map.section != NULL )
+			section_set(state[0], state[1]);
+	}
+
+	// more than half a turn per recorded period is a rotation
+	const double turns = (state[0] - start) / (2.0 * M_PI);
+	if ( turns > 0.5 * MAP_RECORD )
+		return MAP_ROTATION_POSITIVE;
+	if ( turns < -0.5 * MAP_RECORD )
+		return MAP_ROTATION_NEGATIVE;
+	return wrap(state[0]) < 0.0 ? MAP_OSCILLATION_NEGATIVE : MAP_OSCILLATION_POSITIVE;
+}
+
+static void* worker (void* argument) {
+
+	unsigned int row;
+	while ( (row = atomic_fetch_add(&map.next_row, 1)) < map.height && !stopflag ) {
+		const double velocity = map.velocity_max * (1.0 - (2.0 * row + 1.0) / map.height);
+		unsigned int column;
+		for ( column = 0; column < map.width; column++ ) {
+			const double angle = M_PI * ((2.0 * column + 1.0) / map.width - 1.0);
+			const unsigned char class = classify(angle, velocity);
+			if ( map.basin != NULL )
+				map.basin[row * map.width + column] = class;
+		}
+	}
+
+	return NULL;
+}
+
+static int write_image (const char* filename, const char* magic, unsigned int width, unsigned int height,
+		const void* data, size_t size) {
+
+	FILE* file = fopen(filename, "wb");
+	if ( file == NULL ) {
+		perror("fopen");
+		return -1;
+	}
+
+	fprintf(file, "%s\n%u %u\n%s", magic, width, height, strcmp(magic, "P5") == 0 ? "255\n" : "");
+	const int err = fwrite(data, 1, size, file) != size;
+	fclose(file);
+
+	if ( err )
+		fprintf(stderr, "cannot write %s!\n\r", filename);
+	return err ? -1 : 0;
+}
+
+int map_compute (pendulum_configuration* conf, unsigned int width, unsigned int height,
+		const char* basin_filename, const char* section_filename) {
+
+	if ( conf->drive.type == PAR_DRIVE_NONE || conf->drive.omega <= 0.0 || conf->links.count > 0 ) {
+		fprintf(stderr, "maps need a driven single pendulum (see <drive>)!\n\r");
+		return -1;
+	}
+
+	memset(&map, 0, sizeof(map));
+	map.conf = conf;
+	map.width = width;
+	map.height = height;
+	map.velocity_max = 2.0 * sqrt(conf->temp.moment_gravity_substitution / conf->temp.moment_of_inertia);
+	map.section_stride = (width + 7) / 8;
+	atomic_init(&map.next_row, 0);
+
+	if ( basin_filename != NULL )
+		map.basin = calloc(width * height, 1);
+	if ( section_filename != NULL )
+		map.section = calloc(map.section_stride * height, sizeof(atomic_uchar));
+	if ( (basin_filename != NULL && map.basin == NULL) || (section_filename != NULL && map.section == NULL) ) {
+		fprintf(stderr, "cannot allocate maps!\n\r");
+		free(map.basin);
+		free(map.section);
+		return -1;
+	}
+
+	// one thread per core
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if ( cores < 1 ) cores = 1;
+	if ( cores > MAP_THREADS_MAX ) cores = MAP_THREADS_MAX;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pthread_t threads[MAP_THREADS_MAX];
+	long i, started = 0;
+	for ( i = 0; i < cores; i++ )
+		if ( pthread_create(&threads[started], NULL, worker, NULL) == 0 )
+			started++;
+	if ( started == 0 )
+		worker(NULL);
+
+	// signals are only seen by the event loop
+	while ( atomic_load(&map.next_row) < height && !stopflag )
+		ev_wait(200);
+
+	for ( i = 0; i < started; i++ )
+		pthread_join(threads[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	printf("%ux%u initial conditions on %ld threads in %.1f s\r\n", width, height, started > 0 ? started : 1,
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1.0e9);
+
+	int err = stopflag ? -1 : 0;
+	if ( !err && map.basin != NULL )
+		err |= write_image(basin_filename, "P5", width, height, map.basin, width * height);
+	if ( !err && map.section != NULL )
+		err |= write_image(section_filename, "P4", width, height, (const void*) map.section, map.section_stride * height);
+
+	free(map.basin);
+	free((void*) map.section);
+
+	return err;
+}
@@ -0,0 +1,34 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEN_MAP
+#define PEN_MAP
+
+#include "par.h"
+
+/* basin classes, grey levels of the basin map */
+#define MAP_FAILED		0	// integration left the finite numbers
+#define MAP_OSCILLATION_NEGATIVE	64	// oscillation, stroboscopic angle < 0
+#define MAP_OSCILLATION_POSITIVE	128	// oscillation, stroboscopic angle >= 0
+#define MAP_ROTATION_NEGATIVE	192	// net rotation, clockwise
+#define MAP_ROTATION_POSITIVE	255	// net rotation, counterclockwise
+
+int map_compute (pendulum_configuration* conf, unsigned int width, unsigned int height,
+	const char* basin_filename, const char* section_filename);
+
+#endif
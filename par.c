@@ -27,33 +27,34 @@
 
 #include "par.h"
 #include "sol.h"
+#include "hw.h"
 
 xmlXPathContextPtr xpathcontext;
 
 /* low level xml handling */
 
-static inline int open_xml (const char* configname, xmlDocPtr xmldoc) {
+static inline int open_xml (const char* configname, xmlDocPtr* xmldoc) {
 
 	char filename[256];
 	snprintf(filename, sizeof(filename), "configs/%s.xml", configname);
 
-	xmldoc = xmlReadFile(filename, NULL, 0);
+	*xmldoc = xmlReadFile(filename, NULL, 0);
 	
-	if ( xmldoc == NULL ) {
+	if ( *xmldoc == NULL ) {
 		fprintf(stderr, "falling back to default configuration\n\r");
-		xmldoc = xmlReadFile("configs/conf-default.xml", NULL, 0);
+		*xmldoc = xmlReadFile("configs/conf-default.xml", NULL, 0);
 	}
 
-	if ( xmldoc == NULL ) {
+	if ( *xmldoc == NULL ) {
 		fprintf(stderr, "cannot load any configuration\n\r");
 		xmlCleanupParser();
 		return -1;
 	}
 	
-	xpathcontext = xmlXPathNewContext(xmldoc);
+	xpathcontext = xmlXPathNewContext(*xmldoc);
 	if ( xpathcontext == NULL ) {
 		fprintf(stderr, "unable to create XPath context\n\r");
-		xmlFreeDoc(xmldoc);
+		xmlFreeDoc(*xmldoc);
 		xmlCleanupParser();
 		return -1;
 	}
@@ -65,7 +66,7 @@ static inline int open_xml (const char* configname, xmlDocPtr xmldoc) {
 
 static inline int close_xml (xmlDocPtr xmldoc) {
 	xmlXPathFreeContext(xpathcontext);
-	xmlFreeDoc(xmldoc); // no it is not uninitialized
+	xmlFreeDoc(xmldoc);
 	xmlCleanupParser();
 	return 0;
 }
@@ -150,12 +151,81 @@ static int get_parameter (const char* path, PAR_TYPE_T type, ...) {
 	return 0;
 }
 
+/* check whether an (optional) element exists */
+static int has_parameter (const char* path) {
+
+	xmlChar xpathExpr[256];
+	xmlStrPrintf(xpathExpr, 255, "count(%s)", xmlCharStrdup(path));
+
+	const xmlXPathObjectPtr xpathObj = xmlXPathEval(xpathExpr, xpathcontext);
+	if (xpathObj == NULL)
+		return 0;
+
+	const int count = (int) xpathObj->floatval;
+	xmlXPathFreeObject(xpathObj);
+	return count > 0;
+}
+
+/* moments of inertia and gravity from the parameters of rod and bob (also for perturbed copies, see unc.c) */
+void par_derive_moments (pendulum_configuration * data) {
+
+	// calculate distance of center of mass
+
+	data->rod.distance = data->rod.length / 2.0;
+	data->bob.distance = data->rod.length + data->bob.radius;
+
+	// calculate moments of inertia
+
+	data->rod.moment_of_inertia = data->rod.mass * data->rod.distance * data->rod.distance;
+	data->bob.moment_of_inertia = data->bob.mass * data->bob.distance * data->bob.distance;
+
+	// calclulate moments of inertia with respect to distributed mass
+
+	data->rod.moment_of_inertia_distributedmass = data->rod.mass * data->rod.length * data->rod.length / 3.0;
+	data->bob.moment_of_inertia_distributedmass = data->bob.mass * data->bob.radius * data->bob.radius * 2.0 / 5.0 +
+		data->bob.mass * data->bob.distance * data->bob.distance;
+
+	// calculate radius of gyration
+
+	data->rod.distance_gyration = data->rod.moment_of_inertia_distributedmass / data->rod.mass / data->rod.distance;
+	data->bob.distance_gyration = data->bob.moment_of_inertia_distributedmass / data->bob.mass / data->bob.distance;
+
+	// calculate final moment of inertia
+
+	if ( data->model.pointmass ) {
+		data->temp.moment_of_inertia = data->rod.moment_of_inertia +
+			data->bob.moment_of_inertia;
+	} else {
+		data->temp.moment_of_inertia = data->rod.moment_of_inertia_distributedmass +
+			data->bob.moment_of_inertia_distributedmass;
+	}
+
+	// calculate gravitational moment
+
+	if ( data->model.gyration ) {
+		// TODO: this is actually not correct! the radius of gyration only applies to the moment of inertia
+		data->temp.moment_gravity_substitution = data->environment.gravity * 
+			( data->rod.mass * data->rod.distance_gyration + data->bob.mass * data->bob.distance_gyration );
+	} else {
+		data->temp.moment_gravity_substitution = data->environment.gravity * 
+			( data->rod.mass * data->rod.distance + data->bob.mass * data->bob.distance );
+	}
+}
+
 /* high level function, extracts all parameters from loaded xml */
 
 static inline int load_configuration (pendulum_configuration * data, PAR_RESET_T reset) {
 
 	int errors = 0;
 
+	// internal state that outlives a configuration
+
+	if ( reset == PAR_RESET ) {
+		data->temp.driver = NULL;
+		data->temp.driver_stepper = NULL;
+		data->temp.driver_dimension = 0;
+	}
+
 	// geometry parameters
 
 	// TODO persistent
@@ -170,6 +240,9 @@ static inline int load_configuration (pendulum_configuration * data, PAR_RESET_T
 	errors += get_parameter("/pendulum/bearing/friction_constant", DOUBLE, &(data->bearing.friction_constant));
 	errors += get_parameter("/pendulum/bearing/friction_linear", DOUBLE, &(data->bearing.friction_linear));
 	errors += get_parameter("/pendulum/bearing/friction_quadratic", DOUBLE, &(data->bearing.friction_quadratic));
+	data->bearing.friction_static = data->bearing.friction_constant;
+	if ( has_parameter("/pendulum/bearing/friction_static") )
+		errors += get_parameter("/pendulum/bearing/friction_static", DOUBLE, &(data->bearing.friction_static));
 	errors += get_parameter("/pendulum/rod/mass", DOUBLE, &(data->rod.mass));
 	errors += get_parameter("/pendulum/rod/length", DOUBLE, &(data->rod.length));
 	errors += get_parameter("/pendulum/bob/mass", DOUBLE, &(data->bob.mass));
@@ -194,7 +267,123 @@ static inline int load_configuration (pendulum_configuration * data, PAR_RESET_T
 	errors += get_parameter("/pendulum/model/pointmass", BOOL, &(data->model.pointmass));
 	errors += get_parameter("/pendulum/model/gyration", BOOL, &(data->model.gyration));
 	errors += get_parameter("/pendulum/model/initial_angle", DOUBLE, &(data->model.initial_angle));
+	data->model.lyapunov = 0;
+	if ( has_parameter("/pendulum/model/lyapunov") )
+		errors += get_parameter("/pendulum/model/lyapunov", BOOL, &(data->model.lyapunov));
+	data->model.trig_accuracy = 0.0;
+	if ( has_parameter("/pendulum/model/trig_accuracy") )
+		errors += get_parameter("/pendulum/model/trig_accuracy", DOUBLE, &(data->model.trig_accuracy));
+
+	// periodic drive (optional)
+
+	char drive[256] = "none";
+	data->drive.amplitude = 0.0;
+	data->drive.frequency = 0.0;
+	data->drive.phase = 0.0;
+	if ( has_parameter("/pendulum/drive") ) {
+		errors += get_parameter("/pendulum/drive/type", STRING, drive);
+		errors += get_parameter("/pendulum/drive/amplitude", DOUBLE, &(data->drive.amplitude));
+		errors += get_parameter("/pendulum/drive/frequency", DOUBLE, &(data->drive.frequency));
+		if ( has_parameter("/pendulum/drive/phase") )
+			errors += get_parameter("/pendulum/drive/phase", DOUBLE, &(data->drive.phase));
+	}
+	data->drive.omega = 2.0 * M_PI * data->drive.frequency;
+
+	// links of the n-link model (optional), replace rod and bob
+
+	data->links.count = 0;
+	if ( has_parameter("/pendulum/links") ) {
+		char path[256];
+		int i;
+		for ( i = 0; i < PAR_LINKS_MAX; i++ ) {
+			snprintf(path, sizeof(path), "/pendulum/links/link[%d]", i + 1);
+			if ( !has_parameter(path) )
+				break;
+			snprintf(path, sizeof(path), "/pendulum/links/link[%d]/mass", i + 1);
+			errors += get_parameter(path, DOUBLE, &(data->links.mass[i]));
+			snprintf(path, sizeof(path), "/pendulum/links/link[%d]/length", i + 1);
+			errors += get_parameter(path, DOUBLE, &(data->links.length[i]));
+			snprintf(path, sizeof(path), "/pendulum/links/link[%d]/friction", i + 1);
+			errors += get_parameter(path, DOUBLE, &(data->links.friction[i]));
+			snprintf(path, sizeof(path), "/pendulum/links/link[%d]/initial_angle", i + 1);
+			data->links.initial_angle[i] = 0.0;
+			if ( has_parameter(path) )
+				errors += get_parameter(path, DOUBLE, &(data->links.initial_angle[i]));
+			// uniform rod
+			data->links.moment_of_inertia[i] = data->links.mass[i] * data->links.length[i] * data->links.length[i] / 12.0;
+		}
+		data->links.count = i;
+		snprintf(path, sizeof(path), "/pendulum/links/link[%d]", PAR_LINKS_MAX + 1);
+		if ( has_parameter(path) )
+			fprintf(stderr,"only %d links supported, the rest is ignored!\n\r", PAR_LINKS_MAX);
+	}
+
+	// realtime parameters (optional)
+
+	data->realtime.enabled = 0;
+	data->realtime.cpu = -1;
+	data->realtime.priority = 50;
+	if ( has_parameter("/pendulum/realtime") ) {
+		errors += get_parameter("/pendulum/realtime/enabled", BOOL, &(data->realtime.enabled));
+		errors += get_parameter("/pendulum/realtime/cpu", INT, &(data->realtime.cpu));
+		errors += get_parameter("/pendulum/realtime/priority", INT, &(data->realtime.priority));
+	}
+
+	// hardware parameters (optional)
+
+	char gpio_backend[256] = "sysfs";
+	data->hardware.gpio_device[0] = '\0';
+	data->hardware.gpio_line = HW_GPIO_LINE;
+	data->hardware.release_delay = 0.0;
+	data->hardware.release_sync = 0;
+	if ( has_parameter("/pendulum/hardware") ) {
+		errors += get_parameter("/pendulum/hardware/gpio_backend", STRING, gpio_backend);
+		errors += get_parameter("/pendulum/hardware/gpio_line", INT, &(data->hardware.gpio_line));
+		if ( has_parameter("/pendulum/hardware/gpio_device") )
+			errors += get_parameter("/pendulum/hardware/gpio_device", STRING, data->hardware.gpio_device);
+		if ( has_parameter("/pendulum/hardware/release_delay") )
+			errors += get_parameter("/pendulum/hardware/release_delay", DOUBLE, &(data->hardware.release_delay));
+		if ( has_parameter("/pendulum/hardware/release_sync") )
+			errors += get_parameter("/pendulum/hardware/release_sync", BOOL, &(data->hardware.release_sync));
+	}
 	
+	// parameter uncertainties (optional)
+
+	memset(&(data->uncertainty), 0, sizeof(data->uncertainty));
+	if ( has_parameter("/pendulum/uncertainty") ) {
+		errors += get_parameter("/pendulum/uncertainty/enabled", BOOL, &(data->uncertainty.enabled));
+		if ( has_parameter("/pendulum/uncertainty/rod_mass") )
+			errors += get_parameter("/pendulum/uncertainty/rod_mass", DOUBLE, &(data->uncertainty.rod_mass));
+		if ( has_parameter("/pendulum/uncertainty/bob_radius") )
+			errors += get_parameter("/pendulum/uncertainty/bob_radius", DOUBLE, &(data->uncertainty.bob_radius));
+		if ( has_parameter("/pendulum/uncertainty/friction_constant") )
+			errors += get_parameter("/pendulum/uncertainty/friction_constant", DOUBLE, &(data->uncertainty.friction_constant));
+		if ( has_parameter("/pendulum/uncertainty/friction_linear") )
+			errors += get_parameter("/pendulum/uncertainty/friction_linear", DOUBLE, &(data->uncertainty.friction_linear));
+		if ( has_parameter("/pendulum/uncertainty/friction_quadratic") )
+			errors += get_parameter("/pendulum/uncertainty/friction_quadratic", DOUBLE, &(data->uncertainty.friction_quadratic));
+		if ( has_parameter("/pendulum/uncertainty/gravity") )
+			errors += get_parameter("/pendulum/uncertainty/gravity", DOUBLE, &(data->uncertainty.gravity));
+	}
+
+	// state estimation from measured angles (optional)
+
+	data->estimation.enabled = 0;
+	data->estimation.friction = 0;
+	snprintf(data->estimation.source, sizeof(data->estimation.source), "/tmp/pendulum.angles");
+	data->estimation.friction_noise = 0.0;
+	if ( has_parameter("/pendulum/estimation") ) {
+		errors += get_parameter("/pendulum/estimation/enabled", BOOL, &(data->estimation.enabled));
+		if ( has_parameter("/pendulum/estimation/source") )
+			errors += get_parameter("/pendulum/estimation/source", STRING, data->estimation.source);
+		errors += get_parameter("/pendulum/estimation/measurement_noise", DOUBLE, &(data->estimation.measurement_noise));
+		errors += get_parameter("/pendulum/estimation/process_noise", DOUBLE, &(data->estimation.process_noise));
+		if ( has_parameter("/pendulum/estimation/friction") )
+			errors += get_parameter("/pendulum/estimation/friction", BOOL, &(data->estimation.friction));
+		if ( has_parameter("/pendulum/estimation/friction_noise") )
+			errors += get_parameter("/pendulum/estimation/friction_noise", DOUBLE, &(data->estimation.friction_noise));
+	}
+
 	// check for parameter input errors
 
 	if ( errors != 0 ) {
@@ -204,6 +393,7 @@ static inline int load_configuration (pendulum_configuration * data, PAR_RESET_T
 
 	// determine solver stepper from string
 
+	data->solver.symplectic = 0;
 	if ( strcmp(stepper, "rk4") == 0 )
 		data->solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_rk4;
 	else if ( strcmp(stepper, "rkf45") == 0 )
@@ -212,66 +402,123 @@ static inline int load_configuration (pendulum_configuration * data, PAR_RESET_T
 		data->solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_rk8pd;
 	else if ( strcmp(stepper, "adams") == 0 )
 		data->solver.stepper = (gsl_odeiv2_step_type*) gsl_odeiv2_step_msadams;
+	else if ( strcmp(stepper, "verlet") == 0 )
+		data->solver.symplectic = 2;
+	else if ( strcmp(stepper, "yoshida4") == 0 )
+		data->solver.symplectic = 4;
+	else if ( strcmp(stepper, "yoshida6") == 0 )
+		data->solver.symplectic = 6;
 	else {
 		fprintf(stderr,"unknown stepper defined in configuration!\n\r");
 		return -1;
 	}
 	// TODO	add further stepper functions
 
+	// determine drive from string
 
+	if ( strcmp(drive, "none") == 0 )
+		data->drive.type = PAR_DRIVE_NONE;
+	else if ( strcmp(drive, "torque") == 0 )
+		data->drive.type = PAR_DRIVE_TORQUE;
+	else if ( strcmp(drive, "pivot") == 0 )
+		data->drive.type = PAR_DRIVE_PIVOT;
+	else {
+		fprintf(stderr,"unknown drive defined in configuration!\n\r");
+		return -1;
+	}
 
-	// calculate distance of center of mass
+	// determine gpio backend from string
 
-	data->rod.distance = data->rod.length / 2.0;
-	data->bob.distance = data->rod.length + data->bob.radius;
+	if ( strcmp(gpio_backend, "sysfs") == 0 )
+		data->hardware.gpio_backend = HW_GPIO_SYSFS;
+	else if ( strcmp(gpio_backend, "gpiod") == 0 )
+		data->hardware.gpio_backend = HW_GPIO_GPIOD;
+	else if ( strcmp(gpio_backend, "mock") == 0 )
+		data->hardware.gpio_backend = HW_GPIO_MOCK;
+	else {
+		fprintf(stderr,"unknown gpio backend defined in configuration!\n\r");
+		return -1;
+	}
 
-	// calculate moments of inertia
 
-	data->rod.moment_of_inertia = data->rod.mass * data->rod.distance * data->rod.distance;
-	data->bob.moment_of_inertia = data->bob.mass * data->bob.distance * data->bob.distance;
+	// moments of the rod and bob model
 
-	// calclulate moments of inertia with respect to distributed mass
+	par_derive_moments(data);
 
-	data->rod.moment_of_inertia_distributedmass = data->rod.mass * data->rod.length * data->rod.length / 3.0;
-	data->bob.moment_of_inertia_distributedmass = data->bob.mass * data->bob.radius * data->bob.radius * 2.0 / 5.0 +
-		data->bob.mass * data->bob.distance * data->bob.distance;
+	// switch between linear, nonlinear and n-link model
+	
+	data->model.equation.dimension = 2;
+	data->model.equation.params = data;
+	if ( data->links.count > 0 ) {
+		data->model.equation.dimension = 2 * data->links.count;
+		data->model.equation.function = sol_kernels->rhs_links;
+		data->model.equation.jacobian = NULL; // explicit steppers only
+		data->model.initial_angle = data->links.initial_angle[0];
+		data->geometry.virtual_rod_length = data->links.length[0] / data->geometry.screen_width * 2.0;
+	} else if ( data->model.linear ) {
+		data->model.equation.function = sol_kernels->rhs_linear;
+		data->model.equation.jacobian = sol_kernels->jac_linear;
+	} else {
+		data->model.equation.function = sol_kernels->rhs;
+		data->model.equation.jacobian = sol_kernels->jac;
+	}
+	data->model.base = data->model.equation;
+	data->model.state_dimension = data->model.equation.dimension;
+
+	// energy is conserved without friction and drive
+
+	data->model.conservative = data->drive.type == PAR_DRIVE_NONE;
+	if ( data->links.count > 0 ) {
+		int i;
+		for ( i = 0; i < data->links.count; i++ )
+			if ( data->links.friction[i] != 0.0 )
+				data->model.conservative = 0;
+	} else if ( data->bearing.friction_constant != 0.0 || data->bearing.friction_linear != 0.0 ||
+			data->bearing.friction_quadratic != 0.0 ) {
+		data->model.conservative = 0;
+	}
 
-	// calculate radius of gyration
+	// symplectic steppers need the acceleration as a function of angle (and time) only
 
-	data->rod.distance_gyration = data->rod.moment_of_inertia_distributedmass / data->rod.mass / data->rod.distance;
-	data->bob.distance_gyration = data->bob.moment_of_inertia_distributedmass / data->bob.mass / data->bob.distance;
+	if ( data->solver.symplectic && ( data->links.count > 0 || data->model.lyapunov ||
+			data->bearing.friction_constant != 0.0 || data->bearing.friction_linear != 0.0 ||
+			data->bearing.friction_quadratic != 0.0 ) ) {
+		fprintf(stderr,"symplectic steppers need an undamped single pendulum!\n\r");
+		return -1;
+	}
 
-	// calculate final moment of inertia
+	data->model.trig = fm_tier(data->model.trig_accuracy);
 
-	if ( data->model.pointmass ) {
-		data->temp.moment_of_inertia = data->rod.moment_of_inertia +
-			data->bob.moment_of_inertia;
-	} else {
-		data->temp.moment_of_inertia = data->rod.moment_of_inertia_distributedmass +
-			data->bob.moment_of_inertia_distributedmass;
+	// constant friction is discontinuous at rest, the adaptive solver stops at the velocity zeros
+
+	if ( data->bearing.friction_static < data->bearing.friction_constant ) {
+		fprintf(stderr,"static friction must not be less than constant friction!\n\r");
+		return -1;
 	}
+	data->model.stick_slip = data->links.count == 0 && data->bearing.friction_constant != 0.0 &&
+		data->solver.adaptive && !data->solver.symplectic && !data->model.lyapunov;
 
-	// calculate gravitational moment
+	if ( data->uncertainty.enabled && data->links.count > 0 ) {
+		fprintf(stderr,"uncertainty band only for the single pendulum!\n\r");
+		return -1;
+	}
 
-	if ( data->model.gyration ) {
-		// TODO: this is actually not correct! the radius of gyration only applies to the moment of inertia
-		data->temp.moment_gravity_substitution = data->environment.gravity * 
-			( data->rod.mass * data->rod.distance_gyration + data->bob.mass * data->bob.distance_gyration );
-	} else {
-		data->temp.moment_gravity_substitution = data->environment.gravity * 
-			( data->rod.mass * data->rod.distance + data->bob.mass * data->bob.distance );
+	if ( data->estimation.enabled && ( data->model.base.jacobian == NULL || !(data->estimation.measurement_noise > 0.0) ||
+			( data->estimation.friction && data->solver.symplectic ) ) ) {
+		fprintf(stderr,"estimation needs a single pendulum, measurement noise (and a non-symplectic stepper for friction)!\n\r");
+		return -1;
 	}
 
-	// switch between linear and nonlinear model
-	
-	data->model.equation.dimension = 2;
-	data->model.equation.params = data;
-	if ( data->model.linear ) {
-		data->model.equation.function = rhs_linear;
-		data->model.equation.jacobian = jac_linear;
-	} else {
-		data->model.equation.function = rhs;
-		data->model.equation.jacobian = jac;
+	// tangent vectors are integrated with the state (needs the jacobian)
+
+	if ( data->model.lyapunov ) {
+		if ( data->model.base.jacobian == NULL ) {
+			fprintf(stderr,"lyapunov exponents need a model with jacobian (single pendulum)!\n\r");
+			return -1;
+		}
+		data->model.equation.dimension = 2 + 4;
+		data->model.equation.function = rhs_tangent;
+		data->model.equation.jacobian = NULL;
 	}
 
 	// default initial condition
@@ -285,8 +532,12 @@ int par_load_configuration (const char* configname, pendulum_configuration * dat
 
 	xmlDocPtr xmldoc;
 
-	if ( open_xml(configname, xmldoc) ) return -1;
-	if ( load_configuration(data, reset) ) return -1;
+	if ( open_xml(configname, &xmldoc) ) return -1;
+	if ( load_configuration(data, reset) ) {
+		close_xml(xmldoc);
+		return -1;
+	}
+	snprintf(data->temp.configname, sizeof(data->temp.configname), "%s", configname);
 	if ( close_xml(xmldoc) ) return -1;
 	return 0;
 }
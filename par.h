@@ -21,6 +21,10 @@
 
 #include <gsl/gsl_odeiv2.h>
 
+#include "fm.h"
+
+#define PAR_LINKS_MAX 8 // links of the n-link model
+
 typedef struct {
 
 	struct {
@@ -41,6 +45,7 @@ typedef struct {
 		double friction_constant;
 		double friction_linear;
 		double friction_quadratic;
+		double friction_static; /* breakaway moment at rest (optional, default friction_constant) */
 	} bearing;
 
 	struct {
@@ -71,6 +76,7 @@ typedef struct {
 		int substeps;
 		int adaptive;
 		gsl_odeiv2_step_type* stepper; /* translated from string */
+		unsigned int symplectic; /* order of a symplectic stepper instead (2, 4, 6), see sol_symplectic_fixed */
 	} solver;
 	
 	struct {
@@ -78,15 +84,88 @@ typedef struct {
 		int pointmass;
 		int gyration;
 		double initial_angle;
+		int lyapunov; /* integrate tangent vectors for lyapunov exponents (optional) */
+		double trig_accuracy; /* absolute accuracy of sin and cos in the equations (optional, 0 for libm) */
 		/* internal variables from here */
-		gsl_odeiv2_system equation;
+		gsl_odeiv2_system equation; /* integrated by the solver */
+		gsl_odeiv2_system base; /* the model itself, equation without tangent vectors */
+		unsigned int state_dimension; /* angles and velocities */
+		int conservative; /* no friction and no drive, the energy is constant */
+		int stick_slip; /* locate the velocity zeros (constant friction), see sol_solve_next_frame */
+		fm_accuracy trig; /* tier of trig_accuracy, see fm.h */
 	} model;
 
+	struct {
+		int type; /* PAR_DRIVE_T, translated from string */
+		double amplitude; /* N m (torque) or m (pivot) */
+		double frequency; /* Hz */
+		double phase; /* rad */
+		/* internal variables following */
+		double omega;
+	} drive; /* optional section, periodic drive of the single pendulum */
+
+	struct {
+		int count; /* 0: single pendulum (rod and bob) */
+		double mass[PAR_LINKS_MAX];
+		double length[PAR_LINKS_MAX];
+		double friction[PAR_LINKS_MAX]; /* linear, relative to the previous link */
+		double initial_angle[PAR_LINKS_MAX]; /* relative to the previous link */
+		/* internal variables following */
+		double moment_of_inertia[PAR_LINKS_MAX]; /* about the center of mass */
+	} links; /* optional section, n-link model */
+
+	struct {
+		int enabled;
+		int cpu; /* -1: no pinning */
+		int priority; /* SCHED_FIFO */
+	} realtime; /* optional section */
+
+	struct {
+		int gpio_backend; /* translated from string, see hw.h */
+		char gpio_device[256];
+		int gpio_line;
+		double release_delay; /* s from gpio edge to motion, see cal.c */
+		int release_sync; /* release so the ball moves at a vblank */
+	} hardware; /* optional section */
+
+	struct {
+		int enabled;
+		double rod_mass; /* standard deviations of the parameters, 0 if exact */
+		double bob_radius;
+		double friction_constant;
+		double friction_linear;
+		double friction_quadratic;
+		double gravity;
+	} uncertainty; /* optional section, see unc.c */
+
+	struct {
+		int enabled;
+		char source[256]; /* fifo with lines "t angle" (s after release, rad) */
+		double measurement_noise; /* rad, standard deviation of a measured angle */
+		double process_noise; /* rad/s^2, standard deviation of unmodelled accelerations (per sqrt(s)) */
+		int friction; /* estimate friction_linear as well */
+		double friction_noise; /* random walk of friction_linear (per sqrt(s)) */
+	} estimation; /* optional section, see est.c */
+
 	/* temporary and inernal variables */
 	struct {
+		double time; /* solver time of angle and velocity */
 		double angle;
+		double velocity;
+		double state[2*PAR_LINKS_MAX]; /* full solver state, see sol_solve_next_frame */
+		double lyapunov[2]; /* running estimate of the exponents, see lya.c */
+		double lyapunov_sum[2];
+		double friction_direction; /* sign of the constant friction while slipping, 0: sign of the velocity */
+		int stick; /* at rest, held by static friction */
+		double energy; /* of the state, see sol_solve_next_frame */
+		double energy_initial;
+		double energy_error; /* relative to the initial energy (conservative models) */
+		double energy_error_max;
+		char configname[64];
 		
-		gsl_odeiv2_driver* driver;
+		gsl_odeiv2_driver* driver; /* kept between runs, see sol_solver_init */
+		const gsl_odeiv2_step_type* driver_stepper;
+		size_t driver_dimension;
 		
 		double moment_of_inertia;
 		double moment_gravity_substitution;
@@ -96,7 +175,9 @@ typedef struct {
 
 typedef enum {DOUBLE, FLOAT, INT, STRING, BOOL} PAR_TYPE_T;
 typedef enum {PAR_RESET, PAR_NOT_RESET} PAR_RESET_T;
+typedef enum {PAR_DRIVE_NONE, PAR_DRIVE_TORQUE, PAR_DRIVE_PIVOT} PAR_DRIVE_T;
 
 int par_load_configuration (const char* configname, pendulum_configuration* data, PAR_RESET_T reset);
+void par_derive_moments (pendulum_configuration* data);
 
 #endif
@@ -17,6 +17,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include "pen.h"
@@ -25,29 +27,94 @@
 #include "hw.h"
 #include "sol.h"
 #include "par.h"
+#include "vid.h"
+#include "ev.h"
+#include "rt.h"
+#include "cal.h"
+#include "shm.h"
+#include "ctl.h"
+#include "map.h"
+#include "lya.h"
+#include "unc.h"
+#include "est.h"
+
+#define UI_FLUSH_PERIOD 0.1 // s between drawing messages while simulating
+#define UI_FLUSH_MAX 8 // messages drawn at once
 
-static inline int setup_and_sim (pendulum_configuration* data) {
-
-	ui_print("starting gl, magnet...\r\n");
+/*
+ * long-lived resources: the gl context (with shaders and geometry), the
+ * magnet gpio and the solver driver are created on the first run and kept
+ * until the program ends, runs only reset their state
+ */
+typedef struct {
+	pendulum_configuration conf;
+	int gl_ready;
+	int hw_ready;
+	/* the gpio opened by hw_init, reopened when the configuration names another */
+	int hw_backend;
+	char hw_device[256];
+	int hw_line;
+} pendulum_session;
+
+static int session_prepare (pendulum_session* session) {
+
+	if ( !session->gl_ready ) {
+		ui_print("starting gl...\r\n");
+		if ( gl_init() ) {
+			fprintf(stderr,"GLES seems not to work.\n");
+			return -1;
+		}
+		session->gl_ready = 1;
+	}
 
-	// init gl
-	if ( gl_init() ) {
-		fprintf(stderr,"GLES seems not to work.\n");
-		return -1;
+	// a loaded configuration may name another gpio, hw_init closes the old one
+	const pendulum_configuration* conf = &session->conf;
+	if ( !session->hw_ready || session->hw_backend != conf->hardware.gpio_backend ||
+			strcmp(session->hw_device, conf->hardware.gpio_device) != 0 ||
+			session->hw_line != conf->hardware.gpio_line ) {
+		ui_print("starting magnet...\r\n");
+		session->hw_ready = 0;
+		if ( hw_init(conf->hardware.gpio_backend, conf->hardware.gpio_device, conf->hardware.gpio_line) ) {
+			fprintf(stderr,"magnet check failed! magnet wont work!\n");
+			return -1;
+		}
+		session->hw_ready = 1;
+		session->hw_backend = conf->hardware.gpio_backend;
+		snprintf(session->hw_device, sizeof(session->hw_device), "%s", conf->hardware.gpio_device);
+		session->hw_line = conf->hardware.gpio_line;
 	}
-	gl_update_geometry(0.0f, 0.0f, 0.0f, data);
 
-	// init magnet
-	if ( hw_magnet_check() ) {
-		fprintf(stderr,"magnet check failed! magnet wont work!\n");
+	return 0;
+}
+
+static void session_terminate (pendulum_session* session) {
+
+	if ( session->gl_ready )
 		gl_terminate();
+	if ( session->hw_ready )
+		hw_terminate();
+	sol_solver_free(&session->conf);
+
+	session->gl_ready = 0;
+	session->hw_ready = 0;
+}
+
+static inline int setup_and_sim (pendulum_session* session) {
+
+	pendulum_configuration* data = &session->conf;
+
+	if ( session_prepare(session) )
+		return -1;
+
+	// reset display state to the (newly loaded) configuration
+	gl_reset(data);
+	gl_update_geometry(0.0f, 0.0f, 0.0f, data);
+	if ( gl_links_init(data) || gl_band_init(data) )
 		return -1;
-	}
 
 	// start magnet
 	if ( hw_magnet_acquire() ) {
 		fprintf(stderr,"magnet could not be turned on.\n");
-		gl_terminate();
 		return -1;
 	}
 
@@ -59,23 +126,44 @@ static inline int setup_and_sim (pendulum_configuration* data) {
 
 	ui_print("graphical setup...\r\n");
 
+	// calculate/aestimate frame rate
+	sol_calculate_frame_duration();
+
+	// "start" on the control socket releases right after the first frame
+	const int autostart = ctl_take_release();
+
 	// allow user to set up initial condition (and adjust alignment)
+	int dirty = 1;
 	while ( !simflag && !setupflag && !stopflag ) {
 
-		// get keyboard input
-		ui_listen_setup(data, &simflag, &setupflag);
-
-		// calculate/aestimate frame rate
-		sol_calculate_frame_duration();
+		// get keyboard input, handle all pending keys before drawing
+		const int input = ui_listen_setup(data, &simflag, &setupflag);
+		if ( input == UI_INPUT_REDRAW )
+			dirty = 1;
+		if ( input != UI_INPUT_NONE )
+			continue;
+
+		// draw the frame only if something changed
+		if ( dirty ) {
+			gl_links_update(data, NULL);
+			gl_band_update(data->temp.angle, 0.0f);
+			gl_draw_frame(data->temp.angle);
+			dirty = 0;
+			if ( autostart )
+				setupflag = 1;
+			continue;
+		}
 
-		// draw the frame
-		gl_draw_frame(data->temp.angle);
+		// nothing to do until the next key press, command (or signal)
+		ui_flush(UI_FLUSH_MAX);
+		if ( (ev_wait(-1) & EV_CTL) && ctl_handle(data, CTL_SETUP) == UI_INPUT_REDRAW )
+			dirty = 1;
 	}
 
 	if ( simflag ) {
 		ui_print("aborted during setup...\r\n");
-		hw_magnet_release();
-		gl_terminate();
+		hw_magnet_release(NULL);
+		gl_blank();
 		return 0;
 	}
 
@@ -84,27 +172,83 @@ static inline int setup_and_sim (pendulum_configuration* data) {
 	// initialize solver
 	if ( sol_solver_init(data) ) {
 		ui_print("solver initialization failed.\r\n");
-		hw_magnet_release();
-		gl_terminate();
-		sol_solver_terminate(data);
+		hw_magnet_release(NULL);
+		gl_blank();
 		return 0;
 	}
 
-	// release pendulum
-	if ( hw_magnet_release() ) {
+	// realtime scheduling for the simulation loop (if configured)
+	rt_enter(data);
+	rt_jitter_reset();
+
+	// sigma points of the uncertainty band (if configured)
+	unc_init(data);
+
+	// with vsync the swap paces the frames, otherwise the timer does
+	const double period = gl_vblank_measure(data->temp.angle);
+	const int vsync = period > 0.0;
+	if ( vsync )
+		sol_set_frame_duration(period);
+
+	// synchronised release: the ball starts moving at a vblank (t = 0 is on screen)
+	struct timespec release;
+	int scheduled = 0;
+	if ( data->hardware.release_sync ) {
+		if ( vsync && gl_vblank_before(data->hardware.release_delay, &release) == 0 )
+			scheduled = 1;
+		else
+			ui_print("no vsync, releasing immediately...\r\n");
+	}
+
+	// release pendulum, t = 0 is the release edge
+	struct timespec edge;
+	if ( (scheduled ? hw_magnet_release_at(&release, &edge) : hw_magnet_release(&edge)) ) {
 		fprintf(stderr,"magnet not released?\n\r");
-		gl_terminate();
+		rt_leave();
 		sol_solver_terminate(data);
 		return -1;
 	}
 
-	// get start time
-	sol_save_start_time();
+	sol_set_start_time(&edge, data->hardware.release_delay);
+
+	struct timespec start;
+	sol_get_start_time(&start);
+	shm_run_begin(data, &start);
+
+	gl_trail_reset(data);
+
+	// measured angles correct the simulation (if configured)
+	if ( est_start(data) )
+		ui_print("no measurements, simulating without estimation...\r\n");
+
+	// messages are drawn at a low rate while simulating, without vsync every
+	// timer tick is a frame and every "flush" ticks messages are drawn
+	const double frame = sol_get_frame_duration();
+	const unsigned int flush = vsync || frame >= UI_FLUSH_PERIOD ? 1 : (unsigned int) (UI_FLUSH_PERIOD / frame);
+	unsigned int ticks = 0;
+	ev_timer_start(vsync ? UI_FLUSH_PERIOD : frame);
 
 	// simulation loop
 	while ( !simflag && !stopflag ) {
-		// get keyboard input if available
-		ui_listen_simulation(data, &simflag);
+		// get keyboard input if available, without vsync sleep until the next frame is due
+		const int events = ev_wait(vsync ? 0 : -1);
+		if ( events & EV_INPUT ) {
+			int input;
+			while ( (input = ui_listen_simulation(data, &simflag)) != UI_INPUT_NONE )
+				// paused, slowed or seeked, the run no longer follows the real pendulum
+				if ( input == UI_INPUT_TIME )
+					est_stop(data);
+		}
+		if ( (events & EV_TICK) && ++ticks % flush == 0 )
+			ui_flush(UI_FLUSH_MAX);
+		if ( events & EV_CTL )
+			ctl_handle(data, CTL_SIM);
+		if ( events & EV_EST )
+			est_handle(data);
+
+		// woken by input, a command or a measurement before the frame is due
+		if ( !vsync && !(events & EV_TICK) )
+			continue;
 
 		// calculate target time for next frame
 		sol_calculate_time_next_frame();
@@ -115,14 +259,35 @@ static inline int setup_and_sim (pendulum_configuration* data) {
 
 		sol_debug_time_integrity();
 
+		// publish the state for other processes
+		shm_publish(data);
+
 		// draw the frame
+		double mean, sigma;
+		unc_advance(data, &mean, &sigma);
+		gl_band_update(mean, sigma);
+
+		gl_trail_push(data->temp.angle, data->temp.velocity);
+		gl_links_update(data, data->temp.state);
 		gl_draw_frame(data->temp.angle);
+		rt_jitter_add(sol_frame_lateness());
 
 		//sol_debug_time ();
 	}
 
-	// shutdown
-	gl_terminate();
+	ev_timer_stop();
+	est_stop(data);
+	shm_run_end();
+	rt_leave();
+	rt_jitter_report();
+
+	if ( data->model.conservative )
+		ui_print("relative energy error: %.2e (max %.2e)\r\n", data->temp.energy_error, data->temp.energy_error_max);
+	if ( data->model.lyapunov )
+		ui_print("lyapunov exponents: %.4f %.4f 1/s\r\n", data->temp.lyapunov[0], data->temp.lyapunov[1]);
+
+	// end of run, resources are kept for the next one
+	gl_blank();
 	sol_solver_terminate(data);
 
 	ui_print("simulation terminated...\r\n");
@@ -130,52 +295,154 @@ static inline int setup_and_sim (pendulum_configuration* data) {
 	return 0;
 }
 
-void sigcatch (int sig) {
-	fprintf(stderr,"program aborted!\n\r");
-	stopflag = 1;
+static void usage (const char* name) {
+	fprintf(stderr, "usage: %s [-c configuration] [-x video.y4m [-t seconds] [-r fps] [-s widthxheight]] [-k swings.txt] [-m basin.pgm] [-p section.pbm] [-l parameter:from:to:steps [-t seconds]]\n", name);
 }
 
-void init_signals () {
-	if( (int) signal(SIGINT,sigcatch) < 0 ) {
-		fprintf(stderr,"could not attach signal handler!\n\r");
+int main (int argc, char *argv[]) {
+
+	const char* configname = "conf-default";
+	const char* videofile = NULL;
+	const char* swingfile = NULL;
+	const char* basinfile = NULL;
+	const char* sectionfile = NULL;
+	const char* scan = NULL;
+	double duration = 60.0;
+	unsigned int fps = 60, width = 1280, height = 720;
+
+	int option;
+	while ( (option = getopt(argc, argv, "c:x:t:r:s:k:m:p:l:h")) != -1 ) {
+		switch ( option ) {
+			case 'c':
+				configname = optarg;
+				break;
+			case 'x':
+				videofile = optarg;
+				break;
+			case 't':
+				duration = atof(optarg);
+				break;
+			case 'r':
+				fps = atoi(optarg);
+				break;
+			case 'm':
+				basinfile = optarg;
+				break;
+			case 'p':
+				sectionfile = optarg;
+				break;
+			case 'l':
+				scan = optarg;
+				break;
+			case 'k':
+				swingfile = optarg;
+				break;
+			case 's':
+				if ( sscanf(optarg, "%ux%u", &width, &height) != 2 ) {
+					usage(argv[0]);
+					return -1;
+				}
+				break;
+			default:
+				usage(argv[0]);
+				return -1;
+		}
 	}
-	if( (int)signal(SIGQUIT,sigcatch) < 0 ) {
-		fprintf(stderr,"could not attach signal handler!\n\r");
+
+	printf("initializing program (%s kernels)...\r\n", sol_kernels_select());
+
+	stopflag = 0;
+
+	if ( ev_init() ) {
+		fprintf(stderr,"event loop initialization failed.\n\r");
+		return -1;
 	}
-	if( (int) signal(SIGTERM,sigcatch) < 0 ) {
-		fprintf(stderr,"could not attach signal handler!\n\r");
+
+	static pendulum_session session;
+	pendulum_configuration* conf = &session.conf;
+	if ( par_load_configuration(configname, conf, PAR_RESET) ) return -1;
+
+	// release delay calibration from a measured swing series
+
+	if ( swingfile != NULL ) {
+		const int err = cal_release_delay(conf, swingfile);
+		sol_solver_free(conf);
+		ev_terminate();
+		return err ? -1 : 0;
 	}
-}
 
-int main (int argc, char *argv[]) {
+	// basin of attraction and poincare section of a driven pendulum (size from -s)
 
-	printf("initializing program...\r\n");
+	if ( basinfile != NULL || sectionfile != NULL ) {
+		const int err = map_compute(conf, width, height, basinfile, sectionfile);
+		ev_terminate();
+		return err ? -1 : 0;
+	}
 
-	stopflag = 0;
-	struct timespec tpause, tremaining;
-	tpause.tv_sec = 0;
-	tpause.tv_nsec = 10000000;
+	// lyapunov exponents over a parameter range (duration from -t)
+
+	if ( scan != NULL ) {
+		const int err = lya_scan(conf, scan, duration);
+		ev_terminate();
+		return err ? -1 : 0;
+	}
 
-	init_signals();
+	// headless video export, no console user interface and no magnet
 
-	pendulum_configuration conf;
-	if ( par_load_configuration("conf-default", &conf, PAR_RESET) ) return -1;
+	if ( videofile != NULL ) {
+		printf("exporting %.1f s at %u fps to %s...\r\n", duration, fps, videofile);
+		const int err = vid_export(conf, videofile, duration, fps, width, height);
+		sol_solver_free(conf);
+		ev_terminate();
+		if ( err ) return -1;
+		printf("export complete...\r\n");
+		return 0;
+	}
 
 	if ( ui_init() ) {
 		fprintf(stderr,"ui initialization failed.\n\r");
 		return -1;
 	}
 
+	// live state for other processes (optional)
+	if ( shm_init() )
+		ui_print("state is not published to shared memory...\r\n");
+
+	// scripted control (optional)
+	if ( ctl_init(CTL_PATH) )
+		ui_print("no control socket...\r\n");
+
 	while ( !stopflag ) {
-		if ( ui_listen_config(&conf, &stopflag) == 1 ) {
+
+		// sleep until keyboard input, a command or signal, jobs run in slices in between
+		const int events = ev_wait(ctl_job_pending() ? 0 : -1);
+
+		int input = UI_INPUT_NONE;
+		if ( events & EV_CTL )
+			input = ctl_handle(conf, CTL_IDLE);
+
+		// ncurses may have read ahead, handle every pending key
+		while ( !stopflag && input != UI_INPUT_START && (events & EV_INPUT) &&
+				(input = ui_listen_config(conf, &stopflag)) != UI_INPUT_NONE );
+
+		if ( input == UI_INPUT_START && !stopflag ) {
+			// a run takes the solver over, the control socket refuses this while a job runs
+			ctl_job_cancel();
 			ui_clear();
-			if ( setup_and_sim(&conf) != 0 )
+			if ( setup_and_sim(&session) != 0 )
 				stopflag = 1;
+		} else if ( !stopflag && !(events & (EV_CTL | EV_INPUT)) ) {
+			ctl_job_run();
 		}
-		nanosleep(&tpause,&tremaining);
+
+		ui_flush(UI_FLUSH_MAX);
 	}
 
+	session_terminate(&session);
+	shm_terminate();
+	ctl_terminate();
 	ui_terminate();
+	ev_terminate();
 
 	printf("shutdown complete...\r\n");
 
@@ -0,0 +1,183 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <malloc.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+#include "ui.h"
+
+#define RT_STACK_PREFAULT (256*1024) // bytes of stack touched before the run
+#define RT_HEAP_PREFAULT (1024*1024) // bytes of heap touched and kept in the arena
+#define RT_TRIM_THRESHOLD (128*1024) // glibc defaults, restored after the run
+#define RT_MMAP_MAX 65536
+
+/*
+ * realtime mode for the simulation loop: the calling thread is pinned to one
+ * core, scheduled SCHED_FIFO and all memory is locked, every step is optional
+ * and falls back to normal scheduling if the process lacks the privileges
+ * (CAP_SYS_NICE, CAP_IPC_LOCK or a sufficient RLIMIT_RTPRIO/RLIMIT_MEMLOCK)
+ */
+static struct {
+	int active;
+	int pinned;
+	int scheduled;
+	int locked;
+	cpu_set_t affinity;
+	int policy;
+	struct sched_param param;
+} saved;
+
+/* frame lateness statistics (welford), see rt_jitter_add */
+static struct {
+	unsigned long frames;
+	unsigned long late;
+	double mean;
+	double m2;
+	double max;
+} jitter;
+
+static void prefault_stack () {
+	volatile char stack[RT_STACK_PREFAULT];
+	memset((char*) stack, 0, sizeof(stack));
+}
+
+/* the pages already mapped are locked, allocations during the run come from this headroom */
+static void prefault_heap () {
+	volatile char* heap = malloc(RT_HEAP_PREFAULT);
+	if ( heap == NULL )
+		return;
+	const long page = sysconf(_SC_PAGESIZE);
+	long i;
+	for ( i = 0; i < RT_HEAP_PREFAULT; i += page )
+		heap[i] = 0; // volatile, a memset before free would be optimised away
+	free((char*) heap); // neither trimmed nor unmapped, see mallopt
+}
+
+int rt_enter (pendulum_configuration* conf) {
+
+	memset(&saved, 0, sizeof(saved));
+
+	if ( !conf->realtime.enabled )
+		return 0;
+
+	saved.active = 1;
+
+	// core pinning
+
+	if ( conf->realtime.cpu >= 0 ) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(conf->realtime.cpu, &set);
+		if ( sched_getaffinity(0, sizeof(saved.affinity), &saved.affinity) == 0 &&
+				sched_setaffinity(0, sizeof(set), &set) == 0 )
+			saved.pinned = 1;
+		else
+			ui_print("realtime: pinning to cpu %d failed: %s\r\n", conf->realtime.cpu, strerror(errno));
+	}
+
+	// fixed priority scheduling
+
+	saved.policy = sched_getscheduler(0);
+	sched_getparam(0, &saved.param);
+
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = conf->realtime.priority;
+	if ( param.sched_priority < sched_get_priority_min(SCHED_FIFO) )
+		param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	if ( param.sched_priority > sched_get_priority_max(SCHED_FIFO) )
+		param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+	if ( sched_setscheduler(0, SCHED_FIFO, &param) == 0 )
+		saved.scheduled = 1;
+	else
+		ui_print("realtime: SCHED_FIFO not available: %s\r\n", strerror(errno));
+
+	// lock all pages, keep the heap from shrinking or using fresh mappings
+
+	if ( mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ) {
+		saved.locked = 1;
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+		prefault_stack();
+		prefault_heap();
+	} else {
+		ui_print("realtime: memory not locked: %s\r\n", strerror(errno));
+	}
+
+	if ( saved.pinned && saved.scheduled && saved.locked )
+		ui_print("realtime: cpu %d, SCHED_FIFO priority %d, memory locked\r\n",
+			conf->realtime.cpu, param.sched_priority);
+
+	return 0;
+}
+
+void rt_leave () {
+
+	if ( !saved.active )
+		return;
+
+	if ( saved.locked ) {
+		munlockall();
+		mallopt(M_TRIM_THRESHOLD, RT_TRIM_THRESHOLD);
+		mallopt(M_MMAP_MAX, RT_MMAP_MAX);
+	}
+	if ( saved.scheduled )
+		sched_setscheduler(0, saved.policy, &saved.param);
+	if ( saved.pinned )
+		sched_setaffinity(0, sizeof(saved.affinity), &saved.affinity);
+
+	saved.active = 0;
+}
+
+void rt_jitter_reset () {
+	memset(&jitter, 0, sizeof(jitter));
+}
+
+/* lateness: time the frame was finished after its target time "t_sol_final" (s) */
+void rt_jitter_add (double lateness) {
+
+	jitter.frames++;
+	if ( lateness > 0.0 )
+		jitter.late++;
+	if ( lateness > jitter.max || jitter.frames == 1 )
+		jitter.max = lateness;
+
+	const double delta = lateness - jitter.mean;
+	jitter.mean += delta / jitter.frames;
+	jitter.m2 += delta * (lateness - jitter.mean);
+}
+
+void rt_jitter_report () {
+
+	if ( jitter.frames < 2 )
+		return;
+
+	ui_print("frames %lu (%lu late), offset to target %.3f ms, jitter %.3f ms, max %.3f ms\r\n",
+		jitter.frames, jitter.late, jitter.mean * 1.0e3,
+		sqrt(jitter.m2 / (jitter.frames - 1)) * 1.0e3, jitter.max * 1.0e3);
+}
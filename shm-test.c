@@ -0,0 +1,52 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define SHM_READER_ONLY
+#include "shm.h"
+
+/* prints the state published by a running "pen" ten times a second */
+int main (int argc, char *argv[]) {
+
+	const int fd = shm_open(SHM_NAME, O_RDONLY, 0);
+	if ( fd == -1 ) {
+		fprintf(stderr, "pen is not running!\n");
+		return(1);
+	}
+
+	shm_state* shared = (shm_state*) mmap(NULL, sizeof(shm_state), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if ( shared == MAP_FAILED || shared->magic != SHM_MAGIC || shared->version != SHM_VERSION ) {
+		fprintf(stderr, "no compatible shared state!\n");
+		return(1);
+	}
+
+	while (1 == 1) {
+		shm_state snapshot;
+		shm_read(shared, &snapshot);
+		printf("run %u (%s) %s frame %u: t = %.3f s, angle = %.4f rad, velocity = %.4f rad/s, energy = %.6f J, lyapunov = %.4f %.4f 1/s\n",
+			snapshot.run, snapshot.configname, snapshot.running ? "running" : "stopped", snapshot.frame,
+			snapshot.time, snapshot.angle, snapshot.velocity, snapshot.energy,
+			snapshot.lyapunov[0], snapshot.lyapunov[1]);
+		usleep(100 * 1000);
+	}
+}
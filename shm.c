@@ -0,0 +1,127 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "shm.h"
+
+static shm_state* shared = NULL;
+
+/* writer side of the seqlock, see shm_state */
+static inline void write_begin () {
+	const unsigned int sequence = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+	atomic_store_explicit(&shared->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static inline void write_end () {
+	const unsigned int sequence = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+	atomic_store_explicit(&shared->sequence, sequence + 1, memory_order_release);
+}
+
+int shm_init () {
+
+	const int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0644);
+	if ( fd == -1 ) {
+		perror("shm_open");
+		return -1;
+	}
+
+	if ( ftruncate(fd, sizeof(shm_state)) ) {
+		perror("ftruncate");
+		close(fd);
+		return -1;
+	}
+
+	void* memory = mmap(NULL, sizeof(shm_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if ( memory == MAP_FAILED ) {
+		perror("mmap");
+		return -1;
+	}
+
+	shared = (shm_state*) memory;
+	memset(shared, 0, sizeof(shm_state));
+	atomic_init(&shared->sequence, 0);
+	shared->version = SHM_VERSION;
+	atomic_thread_fence(memory_order_release);
+	shared->magic = SHM_MAGIC;
+
+	return 0;
+}
+
+void shm_terminate () {
+
+	if ( shared == NULL )
+		return;
+
+	munmap(shared, sizeof(shm_state));
+	shm_unlink(SHM_NAME);
+	shared = NULL;
+}
+
+void shm_run_begin (pendulum_configuration* conf, const struct timespec* start) {
+
+	if ( shared == NULL )
+		return;
+
+	write_begin();
+	shared->run++;
+	shared->running = 1;
+	snprintf(shared->configname, sizeof(shared->configname), "%s", conf->temp.configname);
+	shared->initial_angle = conf->temp.angle;
+	shared->start_sec = start->tv_sec;
+	shared->start_nsec = start->tv_nsec;
+	shared->frame = 0;
+	shared->time = 0.0;
+	shared->angle = conf->temp.angle;
+	shared->velocity = 0.0;
+	shared->energy = conf->temp.energy_initial;
+	shared->lyapunov[0] = shared->lyapunov[1] = 0.0;
+	write_end();
+}
+
+/* a few stores per frame, no syscalls */
+void shm_publish (pendulum_configuration* conf) {
+
+	if ( shared == NULL )
+		return;
+
+	write_begin();
+	shared->frame++;
+	shared->time = conf->temp.time;
+	shared->angle = conf->temp.angle;
+	shared->velocity = conf->temp.velocity;
+	shared->energy = conf->temp.energy;
+	shared->lyapunov[0] = conf->temp.lyapunov[0];
+	shared->lyapunov[1] = conf->temp.lyapunov[1];
+	write_end();
+}
+
+void shm_run_end () {
+
+	if ( shared == NULL )
+		return;
+
+	write_begin();
+	shared->running = 0;
+	write_end();
+}
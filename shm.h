@@ -0,0 +1,85 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PEN_SHM
+#define PEN_SHM
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define SHM_NAME "/pendulum" // shm_open name, /dev/shm/pendulum
+#define SHM_MAGIC 0x50454e44 // "PEND"
+#define SHM_VERSION 2
+
+/*
+ * live state of the simulation, written once per frame under a seqlock:
+ * "sequence" is odd while the writer changes the record, readers retry
+ * until they copied the record between two equal, even sequence numbers
+ * (see shm_read), the writer never waits for readers
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	atomic_uint sequence;
+
+	/* run metadata, changes with every run */
+	uint32_t run; // number of the run since program start
+	uint32_t running; // 1 while simulating
+	char configname[64];
+	double initial_angle; // rad
+	int64_t start_sec; // t = 0, CLOCK_MONOTONIC
+	int64_t start_nsec;
+
+	/* state, changes with every frame */
+	uint32_t frame;
+	double time; // s since t = 0
+	double angle; // rad
+	double velocity; // rad/s
+	double energy; // J, relative to the rest position
+	double lyapunov[2]; // 1/s, running estimate (zero if not configured)
+} shm_state;
+
+#ifndef SHM_READER_ONLY
+#include <time.h>
+#include "par.h"
+
+int shm_init ();
+void shm_terminate ();
+void shm_run_begin (pendulum_configuration* conf, const struct timespec* start);
+void shm_publish (pendulum_configuration* conf);
+void shm_run_end ();
+#endif
+
+/* consistent copy of the shared state (for readers), returns the sequence number */
+static inline unsigned int shm_read (shm_state* shared, shm_state* snapshot) {
+
+	unsigned int before, after;
+	do {
+		before = atomic_load_explicit(&shared->sequence, memory_order_acquire);
+		if ( before & 1 )
+			continue;
+		memcpy((void*) snapshot, (const void*) shared, sizeof(shm_state));
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+	} while ( (before & 1) || before != after );
+
+	return before;
+}
+
+#endif
@@ -19,18 +19,57 @@
 #include <math.h>
 #include <gsl/gsl_matrix.h>
 
-#include "sol.h" // why is this needed here?
+#include "sol.h" // SOL_KERNEL
 #include "par.h"
+#include "fm.h"
 
-int rhs (double t, const double y[], double dydt[], void *params) {
+/*
+ * periodic drive of the single pendulum: a torque A cos(W t + phi) at the
+ * bearing or a vertical motion A cos(W t + phi) of the pivot, which changes
+ * gravity to g - A W^2 cos(W t + phi), "s" is sin(angle) (angle if linear)
+ */
+static inline double drive (double t, double s, pendulum_configuration* data) {
+	if ( data->drive.type == PAR_DRIVE_TORQUE )
+		return data->drive.amplitude * cos(data->drive.omega * t + data->drive.phase);
+	if ( data->drive.type == PAR_DRIVE_PIVOT )
+		return s * data->temp.moment_gravity_substitution * data->drive.amplitude * data->drive.omega * data->drive.omega
+			* cos(data->drive.omega * t + data->drive.phase) / data->environment.gravity;
+	return 0.0;
+}
+
+/* derivative of the drive with respect to the angle, "c" is cos(angle) (1 if linear) */
+static inline double drive_dangle (double t, double c, pendulum_configuration* data) {
+	return data->drive.type == PAR_DRIVE_PIVOT ? drive(t, c, data) : 0.0;
+}
+
+/* derivative of the drive with respect to time */
+static inline double drive_dt (double t, double s, pendulum_configuration* data) {
+	if ( data->drive.type == PAR_DRIVE_TORQUE )
+		return - data->drive.amplitude * data->drive.omega * sin(data->drive.omega * t + data->drive.phase);
+	if ( data->drive.type == PAR_DRIVE_PIVOT )
+		return - s * data->temp.moment_gravity_substitution * data->drive.amplitude * pow(data->drive.omega, 3.0)
+			* sin(data->drive.omega * t + data->drive.phase) / data->environment.gravity;
+	return 0.0;
+}
+
+/* moment of gravity and drive on the single pendulum, what friction has to hold at rest */
+double SOL_KERNEL(moment_driving) (double t, const double y[], pendulum_configuration* data) {
+	if ( data->model.linear )
+		return - y[0] * data->temp.moment_gravity_substitution + drive(t, y[0], data);
+	const double s = fm_sin(y[0], data->model.trig);
+	return - s * data->temp.moment_gravity_substitution + drive(t, s, data);
+}
+
+int SOL_KERNEL(rhs) (double t, const double y[], double dydt[], void *params) {
 	pendulum_configuration* data = (pendulum_configuration*) params;
 
-	double M_G = - sin(y[0]) * data->temp.moment_gravity_substitution;
+	const double s = fm_sin(y[0], data->model.trig);
+	double M_G = - s * data->temp.moment_gravity_substitution + drive(t, s, data);
 	double M_D = - y[1] * data->bearing.friction_linear
 			- copysign(
 				y[1] * y[1] * data->bearing.friction_quadratic + 
 				data->bearing.friction_constant,
-			y[1]);
+			data->temp.friction_direction != 0.0 ? data->temp.friction_direction : y[1]);
 
 	dydt[0] = y[1];
 	dydt[1] = (M_G + M_D) / data->temp.moment_of_inertia;
@@ -38,30 +77,34 @@ int rhs (double t, const double y[], double dydt[], void *params) {
 	return GSL_SUCCESS; 
 };
 
-int jac (double t, const double y[], double *dfdy, double dfdt[], void *params) {
+int SOL_KERNEL(jac) (double t, const double y[], double *dfdy, double dfdt[], void *params) {
 	pendulum_configuration* data = (pendulum_configuration*) params;
 	
+	double s, c;
+	fm_sincos(y[0], &s, &c, data->model.trig);
+
 	gsl_matrix_view dfdy_mat = gsl_matrix_view_array(dfdy, 2, 2);
 	gsl_matrix * m = &dfdy_mat.matrix; 
 	gsl_matrix_set(m, 0, 0, 0.0);
 	gsl_matrix_set(m, 0, 1, 1.0);
-	gsl_matrix_set(m, 1, 0, - cos(y[0]) * data->temp.moment_gravity_substitution / data->temp.moment_of_inertia );
-	gsl_matrix_set(m, 1, 1, (- data->bearing.friction_linear + 2.0 * data->bearing.friction_quadratic * y[1]) / data->temp.moment_of_inertia );
+	gsl_matrix_set(m, 1, 0, ( - c * data->temp.moment_gravity_substitution + drive_dangle(t, c, data) )
+		/ data->temp.moment_of_inertia );
+	gsl_matrix_set(m, 1, 1, (- data->bearing.friction_linear - 2.0 * data->bearing.friction_quadratic * fabs(y[1])) / data->temp.moment_of_inertia );
 	dfdt[0] = 0.0;
-	dfdt[1] = 0.0;
+	dfdt[1] = drive_dt(t, s, data) / data->temp.moment_of_inertia;
 	
 	return GSL_SUCCESS;
 }
 
-int rhs_linear (double t, const double y[], double dydt[], void *params) {
+int SOL_KERNEL(rhs_linear) (double t, const double y[], double dydt[], void *params) {
 	pendulum_configuration* data = (pendulum_configuration*) params;	
 
-	double M_G = - y[0] * data->temp.moment_gravity_substitution;
+	double M_G = - y[0] * data->temp.moment_gravity_substitution + drive(t, y[0], data);
 	double M_D = - y[1] * data->bearing.friction_linear
 			- copysign(
 				y[1] * y[1] * data->bearing.friction_quadratic + 
 				data->bearing.friction_constant,
-			y[1]);
+			data->temp.friction_direction != 0.0 ? data->temp.friction_direction : y[1]);
 
 	dydt[0] = y[1];
 	dydt[1] = (M_G + M_D) / data->temp.moment_of_inertia;
@@ -69,17 +112,222 @@ int rhs_linear (double t, const double y[], double dydt[], void *params) {
 	return GSL_SUCCESS; 
 }
 
-int jac_linear (double t, const double y[], double *dfdy, double dfdt[], void *params) {
+int SOL_KERNEL(jac_linear) (double t, const double y[], double *dfdy, double dfdt[], void *params) {
 	pendulum_configuration* data = (pendulum_configuration*) params;
 	
 	gsl_matrix_view dfdy_mat = gsl_matrix_view_array(dfdy, 2, 2);
 	gsl_matrix * m = &dfdy_mat.matrix; 
 	gsl_matrix_set(m, 0, 0, 0.0);
 	gsl_matrix_set(m, 0, 1, 1.0);
-	gsl_matrix_set(m, 1, 0, - data->temp.moment_gravity_substitution / data->temp.moment_of_inertia );
-	gsl_matrix_set(m, 1, 1, (- data->bearing.friction_linear + 2.0 * data->bearing.friction_quadratic * y[1]) / data->temp.moment_of_inertia );
+	gsl_matrix_set(m, 1, 0, ( - data->temp.moment_gravity_substitution + drive_dangle(t, 1.0, data) )
+		/ data->temp.moment_of_inertia );
+	gsl_matrix_set(m, 1, 1, (- data->bearing.friction_linear - 2.0 * data->bearing.friction_quadratic * fabs(y[1])) / data->temp.moment_of_inertia );
 	dfdt[0] = 0.0;
-	dfdt[1] = 0.0;
+	dfdt[1] = drive_dt(t, y[0], data) / data->temp.moment_of_inertia;
 	
 	return GSL_SUCCESS;
 }
+
+/*
+ * model with tangent vectors: y = (angle, velocity, v1, v2) with the columns
+ * v1, v2 of the 2x2 tangent matrix, which follows d/dt V = J(t, y) V with the
+ * jacobian of the model (see lya.c)
+ */
+int SOL_KERNEL(rhs_tangent) (double t, const double y[], double dydt[], void *params) {
+	pendulum_configuration* data = (pendulum_configuration*) params;
+
+	double J[4], dfdt[2];
+	data->model.base.function(t, y, dydt, params);
+	data->model.base.jacobian(t, y, J, dfdt, params);
+
+	int column;
+	for ( column = 0; column < 2; column++ ) {
+		const double* v = y + 2 + 2 * column;
+		dydt[2 + 2 * column] = J[0] * v[0] + J[1] * v[1];
+		dydt[3 + 2 * column] = J[2] * v[0] + J[3] * v[1];
+	}
+
+	return GSL_SUCCESS;
+}
+
+/*
+ * n-link planar pendulum, articulated-body algorithm (featherstone) in planar
+ * spatial algebra: motion vectors (omega, vx, vy), force vectors (n, fx, fy),
+ * every link has its frame in its joint with x along the link, link 1 hangs
+ * from the suspension, x of the zero angle frame points down (gravity)
+ *
+ * y = (q_1 .. q_n, qd_1 .. qd_n) with joint angles relative to the previous
+ * link, the cost is linear in the number of links (no mass matrix)
+ */
+
+typedef double sv[3];
+typedef double sm[3][3];
+
+/* coordinate transform: rotation by theta after translation by (rx, ry) */
+static inline void plnr (sm X, double theta, double rx, double ry, fm_accuracy accuracy) {
+	double s, c;
+	fm_sincos(theta, &s, &c, accuracy);
+	X[0][0] = 1.0;		X[0][1] = 0.0;	X[0][2] = 0.0;
+	X[1][0] = s*rx - c*ry;	X[1][1] = c;	X[1][2] = s;
+	X[2][0] = c*rx + s*ry;	X[2][1] = -s;	X[2][2] = c;
+}
+
+static inline void mul (sv r, const sm X, const sv v) {
+	int i;
+	for ( i = 0; i < 3; i++ )
+		r[i] = X[i][0]*v[0] + X[i][1]*v[1] + X[i][2]*v[2];
+}
+
+static inline void mul_transposed (sv r, const sm X, const sv v) {
+	int i;
+	for ( i = 0; i < 3; i++ )
+		r[i] = X[0][i]*v[0] + X[1][i]*v[1] + X[2][i]*v[2];
+}
+
+/* crm(v) m, motion cross product */
+static inline void cross_motion (sv r, const sv v, const sv m) {
+	r[0] = 0.0;
+	r[1] = v[2]*m[0] - v[0]*m[2];
+	r[2] = -v[1]*m[0] + v[0]*m[1];
+}
+
+/* crf(v) f, force cross product */
+static inline void cross_force (sv r, const sv v, const sv f) {
+	r[0] = -v[2]*f[1] + v[1]*f[2];
+	r[1] = -v[0]*f[2];
+	r[2] = v[0]*f[1];
+}
+
+/* spatial inertia of a uniform rod along x, mass m, length l */
+static inline void rod_inertia (sm I, double m, double l, double Ic) {
+	const double c = l / 2.0;
+	I[0][0] = Ic + m*c*c;	I[0][1] = 0.0;	I[0][2] = m*c;
+	I[1][0] = 0.0;		I[1][1] = m;	I[1][2] = 0.0;
+	I[2][0] = m*c;		I[2][1] = 0.0;	I[2][2] = m;
+}
+
+int SOL_KERNEL(rhs_links) (double t, const double y[], double dydt[], void *params) {
+	pendulum_configuration* data = (pendulum_configuration*) params;
+
+	const int n = data->links.count;
+	const double* q = y;
+	const double* qd = y + n;
+
+	sm Xup[PAR_LINKS_MAX], IA[PAR_LINKS_MAX];
+	sv v[PAR_LINKS_MAX], c[PAR_LINKS_MAX], pA[PAR_LINKS_MAX], U[PAR_LINKS_MAX], a;
+	double d[PAR_LINKS_MAX], u[PAR_LINKS_MAX];
+	int i, j, k;
+
+	// velocities and bias forces, outwards
+
+	for ( i = 0; i < n; i++ ) {
+		plnr(Xup[i], q[i], i == 0 ? 0.0 : data->links.length[i-1], 0.0, data->model.trig);
+
+		const sv vJ = { qd[i], 0.0, 0.0 };
+		if ( i == 0 ) {
+			v[i][0] = vJ[0]; v[i][1] = 0.0; v[i][2] = 0.0;
+		} else {
+			mul(v[i], Xup[i], v[i-1]);
+			v[i][0] += vJ[0];
+		}
+		cross_motion(c[i], v[i], vJ);
+
+		rod_inertia(IA[i], data->links.mass[i], data->links.length[i], data->links.moment_of_inertia[i]);
+		sv h;
+		mul(h, IA[i], v[i]);
+		cross_force(pA[i], v[i], h);
+	}
+
+	// articulated inertias, inwards
+
+	for ( i = n - 1; i >= 0; i-- ) {
+		U[i][0] = IA[i][0][0]; U[i][1] = IA[i][1][0]; U[i][2] = IA[i][2][0];
+		d[i] = U[i][0];
+		u[i] = - data->links.friction[i] * qd[i] - pA[i][0];
+
+		if ( i == 0 )
+			continue;
+
+		sm Ia, T;
+		sv pa, Iac;
+		for ( j = 0; j < 3; j++ )
+			for ( k = 0; k < 3; k++ )
+				Ia[j][k] = IA[i][j][k] - U[i][j] * U[i][k] / d[i];
+		mul(Iac, Ia, c[i]);
+		for ( j = 0; j < 3; j++ )
+			pa[j] = pA[i][j] + Iac[j] + U[i][j] * u[i] / d[i];
+
+		// IA_parent += Xup' Ia Xup, pA_parent += Xup' pa
+		for ( j = 0; j < 3; j++ )
+			for ( k = 0; k < 3; k++ )
+				T[j][k] = Ia[j][0]*Xup[i][0][k] + Ia[j][1]*Xup[i][1][k] + Ia[j][2]*Xup[i][2][k];
+		for ( j = 0; j < 3; j++ )
+			for ( k = 0; k < 3; k++ )
+				IA[i-1][j][k] += Xup[i][0][j]*T[0][k] + Xup[i][1][j]*T[1][k] + Xup[i][2][j]*T[2][k];
+		sv f;
+		mul_transposed(f, Xup[i], pa);
+		for ( j = 0; j < 3; j++ )
+			pA[i-1][j] += f[j];
+	}
+
+	// accelerations, outwards, the base accelerates against gravity
+
+	sv ap = { 0.0, -data->environment.gravity, 0.0 };
+	for ( i = 0; i < n; i++ ) {
+		mul(a, Xup[i], ap);
+		for ( j = 0; j < 3; j++ )
+			a[j] += c[i][j];
+		dydt[n+i] = (u[i] - (U[i][0]*a[0] + U[i][1]*a[1] + U[i][2]*a[2])) / d[i];
+		a[0] += dydt[n+i];
+		dydt[i] = qd[i];
+		ap[0] = a[0]; ap[1] = a[1]; ap[2] = a[2];
+	}
+
+	return GSL_SUCCESS;
+}
+
+/* kinetic and potential energy of the links, potential relative to all links hanging down */
+static double energy_links (const double y[], pendulum_configuration* data) {
+
+	const int n = data->links.count;
+	double angle = 0.0, omega = 0.0, height = 0.0, height_rest = 0.0;
+	double vx = 0.0, vy = 0.0, kinetic = 0.0, potential = 0.0;
+	int i;
+
+	// joint position (x right, y up) and velocity, absolute angle and rate
+	for ( i = 0; i < n; i++ ) {
+		angle += y[i];
+		omega += y[n+i];
+
+		const double m = data->links.mass[i], l = data->links.length[i];
+		const double s = sin(angle), c = cos(angle);
+
+		// center of mass
+		const double cvx = vx + omega * c * l / 2.0;
+		const double cvy = vy + omega * s * l / 2.0;
+		kinetic += 0.5 * m * (cvx*cvx + cvy*cvy) + 0.5 * data->links.moment_of_inertia[i] * omega * omega;
+		potential += m * data->environment.gravity * ( (height - c * l / 2.0) - (height_rest - l / 2.0) );
+
+		// next joint
+		vx += omega * c * l;
+		vy += omega * s * l;
+		height -= c * l;
+		height_rest -= l;
+	}
+
+	return kinetic + potential;
+}
+
+/* mechanical energy relative to the rest position */
+double SOL_KERNEL(energy) (const double y[], pendulum_configuration* data) {
+
+	if ( data->links.count > 0 )
+		return energy_links(y, data);
+
+	const double kinetic = 0.5 * data->temp.moment_of_inertia * y[1] * y[1];
+
+	if ( data->model.linear )
+		return kinetic + 0.5 * data->temp.moment_gravity_substitution * y[0] * y[0];
+
+	return kinetic + data->temp.moment_gravity_substitution * (1.0 - cos(y[0]));
+}
@@ -0,0 +1,98 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gsl/gsl_odeiv2.h>
+#include <gsl/gsl_errno.h>
+
+#include "sol.h"
+#include "par.h"
+
+/*
+ * classical runge-kutta with fixed steps, without driver and global state,
+ * so it can be used from several threads (see map.c)
+ */
+int SOL_KERNEL(rk4_fixed) (const gsl_odeiv2_system* system, double* time, double state[], double h, unsigned int steps) {
+
+	const size_t dimension = system->dimension;
+	double k1[2*PAR_LINKS_MAX], k2[2*PAR_LINKS_MAX], k3[2*PAR_LINKS_MAX], k4[2*PAR_LINKS_MAX], temp[2*PAR_LINKS_MAX];
+	unsigned int n;
+	size_t i;
+
+	// times from the start, no accumulated round off
+	const double start = *time;
+
+	for ( n = 0; n < steps; n++ ) {
+		const double t0 = start + n * h;
+
+		system->function(t0, state, k1, system->params);
+		for ( i = 0; i < dimension; i++ ) temp[i] = state[i] + 0.5 * h * k1[i];
+		system->function(t0 + 0.5 * h, temp, k2, system->params);
+		for ( i = 0; i < dimension; i++ ) temp[i] = state[i] + 0.5 * h * k2[i];
+		system->function(t0 + 0.5 * h, temp, k3, system->params);
+		for ( i = 0; i < dimension; i++ ) temp[i] = state[i] + h * k3[i];
+		system->function(t0 + h, temp, k4, system->params);
+
+		for ( i = 0; i < dimension; i++ )
+			state[i] += h / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]);
+	}
+
+	*time = start + steps * h;
+
+	return GSL_SUCCESS;
+}
+
+/*
+ * symplectic steppers for the undamped single pendulum (the acceleration
+ * depends on angle and time only): stormer-verlet (kick-drift-kick) and its
+ * compositions of order 4 and 6 (yoshida 1990, solution a), the energy error
+ * stays bounded with large steps, the acceleration at the end of a
+ * substep is reused for the first kick of the next one
+ */
+static const double verlet[] = { 1.0 };
+static const double yoshida4[] = { 1.3512071919596578, -1.7024143839193153, 1.3512071919596578 };
+static const double yoshida6[] = { 0.78451361047755726, 0.23557321335935813, -1.1776799841788710,
+	1.3151863206839112, -1.1776799841788710, 0.23557321335935813, 0.78451361047755726 };
+
+int SOL_KERNEL(symplectic_fixed) (const gsl_odeiv2_system* system, unsigned int order, double* time, double state[],
+		double h, unsigned int steps) {
+
+	const double* weights = order == 6 ? yoshida6 : order == 4 ? yoshida4 : verlet;
+	const unsigned int stages = order == 6 ? 7 : order == 4 ? 3 : 1;
+	double dydt[2];
+	unsigned int n, i;
+
+	// times from the start, no accumulated round off
+	const double start = *time;
+
+	system->function(start, state, dydt, system->params);
+	for ( n = 0; n < steps; n++ ) {
+		double t0 = start + n * h;
+		for ( i = 0; i < stages; i++ ) {
+			const double tau = weights[i] * h;
+			state[1] += 0.5 * tau * dydt[1];
+			state[0] += tau * state[1];
+			t0 += tau;
+			system->function(i == stages - 1 ? start + (n + 1) * h : t0, state, dydt, system->params);
+			state[1] += 0.5 * tau * dydt[1];
+		}
+	}
+
+	*time = start + steps * h;
+
+	return GSL_SUCCESS;
+}
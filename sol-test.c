@@ -16,31 +16,51 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include <gsl_odeiv2.h>
-#include <gsl/gsl_errno.h>
-#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
 
 #include "par.h"
+#include "sol.h"
+#include "pen.h"
 
-int equation_standard (double t, const double y[], double dydt[], pendulum_configuration* p) {
+/* the solver reports through the console user interface, not linked here */
+void ui_print (const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	vfprintf(stderr, format, arguments);
+	va_end(arguments);
+}
 
-	//pendulum_data* p = (pendulum_data*) params;
+/* usage: sol-test [configuration [seconds]], prints time, angle, velocity and energy per frame */
+int main (int argc, char *argv[]) {
 
-	dydt[0] = y[1];
-	dydt[1] = - 8.9 / 0.2 * sin(y[0]);
+	pendulum_configuration conf = { 0 };
+	const char* configname = argc > 1 ? argv[1] : "conf-default";
+	const double duration = argc > 2 ? atof(argv[2]) : 10.0;
 
-	return GSL_SUCCESS;
-}
+	sol_kernels_select();
+	if ( par_load_configuration(configname, &conf, PAR_RESET) ) {
+		fprintf(stderr, "cannot load %s!\n", configname);
+		return(1);
+	}
 
-int main (int argc, char *argv[]) {
+	conf.temp.angle = conf.model.initial_angle;
+	if ( sol_solver_init(&conf) ) {
+		fprintf(stderr, "solver initialization failed!\n");
+		return(1);
+	}
 
-	pendulum_configuration conf;
+	const unsigned int frames = duration * 60.0;
+	unsigned int n;
+	for ( n = 1; n <= frames; n++ ) {
+		sol_set_time_next_frame(n / 60.0);
+		sol_solve_next_frame(&conf);
+		printf("%.4f %.6f %.6f %.6f\n", conf.temp.time, conf.temp.angle, conf.temp.velocity, conf.temp.energy);
+	}
 
-	open_xml("conf-default");
-	load_configuration(&conf);
-	close_xml();	
+	sol_solver_terminate(&conf);
+	sol_solver_free(&conf);
 
-	gsl_odeiv2_system equation = {equation_standard, NULL, 2, &conf};
-	
-	return 0;
+	return(0);
 }
@@ -17,19 +17,49 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <math.h>
 #include <gsl/gsl_odeiv2.h>
 #include <gsl/gsl_errno.h>
 
 #include "sol.h"
 #include "pen.h"
 #include "ui.h"
+#include "cpu.h"
+#include "fm.h"
 
-double y[2] = {0.0,0.0};
+double y[2*PAR_LINKS_MAX] = {0.0,0.0};
 double t = 0.0;
 struct timespec time_before, time_after, time_now, time_start;
 double t_sol_final, t_frame_duration; // dont move to data/params!
 
+/*
+ * time control: the simulated time runs "time_scale" times as fast as the
+ * wall clock from "time_anchor" (simulated) at "time_start" (wall), 0 is a
+ * pause, the frames are due at "t_frame_due" (wall, from time_start)
+ *
+ * the state of a run is kept in a ring of checkpoints, one per
+ * SOL_CHECKPOINT_PERIOD of simulated time (slot, stored at the first frame
+ * within), a seek restores the nearest one before the target and
+ * integrates less than a period, the ring holds the last SOL_CHECKPOINTS
+ */
+#define SOL_CHECKPOINTS 128
+#define SOL_CHECKPOINT_PERIOD 0.25 // s of simulated time
+
+typedef struct {
+	long slot; // floor(time / SOL_CHECKPOINT_PERIOD), -1 if empty
+	double time;
+	double state[2*PAR_LINKS_MAX]; // with tangent vectors
+	double step; // of the adaptive driver
+	double friction_direction;
+	int stick;
+	double lyapunov_sum[2];
+} sol_checkpoint;
+
+static sol_checkpoint checkpoints[SOL_CHECKPOINTS];
+static double time_scale = 1.0, time_anchor = 0.0, t_frame_due = 0.0;
+
 /* timing functions */
 
 /* returns difference in seconds */
@@ -40,6 +70,15 @@ double time_substract (struct timespec* time_later, struct timespec* time_earlie
 /* save current time to "time_start" */
 void sol_save_start_time () {
 	clock_gettime(CLOCK_MONOTONIC, &time_start);
+	time_anchor = 0.0;
+}
+
+/* anchor t = 0 to a given time plus delay (s), e.g. the release edge of the magnet (CLOCK_MONOTONIC) */
+void sol_set_start_time (const struct timespec* start, double delay) {
+	const long long nsec = (long long) start->tv_sec * 1000000000LL + start->tv_nsec + (long long) (delay * 1.0e9);
+	time_start.tv_sec = nsec / 1000000000LL;
+	time_start.tv_nsec = nsec % 1000000000LL;
+	time_anchor = 0.0;
 }
 
 /* calculate or retrieve frame rate */
@@ -57,10 +96,48 @@ void sol_calculate_frame_duration () {
 	*/
 }
 
+/* t = 0 of the current run (CLOCK_MONOTONIC) */
+void sol_get_start_time (struct timespec* start) {
+	*start = time_start;
+}
+
+/* use a measured frame duration (s), e.g. from the swap timing */
+void sol_set_frame_duration (double duration) {
+	t_frame_duration = duration;
+}
+
+double sol_get_frame_duration () {
+	return t_frame_duration;
+}
+
 /* calculate the target time of the next frame and store to "t_sol_final" */
 void sol_calculate_time_next_frame () {
 	clock_gettime(CLOCK_MONOTONIC, &time_now);
-	t_sol_final = time_substract(&time_now,&time_start) + t_frame_duration;
+	t_frame_due = time_substract(&time_now,&time_start) + t_frame_duration;
+	t_sol_final = time_anchor + time_scale * t_frame_due;
+}
+
+/* set the target time of the next frame directly (virtual time, e.g. video export) */
+void sol_set_time_next_frame (double t_final) {
+	t_sol_final = t_final;
+	t_frame_due = t_final;
+}
+
+/* time the current frame is finished after its target time (negative if early) */
+double sol_frame_lateness () {
+	clock_gettime(CLOCK_MONOTONIC, &time_now);
+	return time_substract(&time_now,&time_start) - t_frame_due;
+}
+
+/* simulated seconds per second from now on, the run continues from its current time */
+void sol_set_time_scale (double scale) {
+	clock_gettime(CLOCK_MONOTONIC, &time_start);
+	time_anchor = t;
+	time_scale = scale;
+}
+
+double sol_get_time_scale () {
+	return time_scale;
 }
 
 /* a debug function */
@@ -74,11 +151,9 @@ void sol_debug_time () {
 /* another debug function */
 void sol_debug_time_integrity () {
 	clock_gettime(CLOCK_MONOTONIC, &time_now);
-	if ( time_substract(&time_now,&time_start) > t_sol_final ) {
-		const double time_diff = time_substract(&time_now,&time_start) - t_sol_final;
-		char errormsg[256];
-		snprintf(errormsg, sizeof(errormsg), "Next frame is from the past! time delay: %f s\n\r", time_diff);
-		ui_print(errormsg);
+	if ( time_substract(&time_now,&time_start) > t_frame_due ) {
+		const double time_diff = time_substract(&time_now,&time_start) - t_frame_due;
+		ui_print("Next frame is from the past! time delay: %f s\n\r", time_diff);
 		if ( time_diff > 1.0 )
 			simflag = 1;
 	}
@@ -88,72 +163,507 @@ void sol_debug_time_integrity () {
 
 // Data Type: gsl_error_handler_t
 void sol_gsl_error_handler (const char * reason, const char * file, int line, int gsl_errno) {
-	char errormsg[256];
-	snprintf(errormsg, sizeof(errormsg), "gsl %d: %s", gsl_errno, reason);
-	ui_print(errormsg);
+	ui_print("gsl %d: %s", gsl_errno, reason);
 	simflag = 1;
 	// maybe need sigkill or sigint?
 }
 
-/* this function is called before the simulation */
-int sol_solver_init (pendulum_configuration* conf) {
+/*
+ * stick-slip: the constant friction of the single pendulum changes its sign
+ * with the velocity, a discontinuity the adaptive controller only passes
+ * with tiny steps (and chatters near rest)
+ *
+ * the direction of the friction is kept fixed while slipping, so the
+ * equation is smooth, a zero of the velocity within a step is located on
+ * the hermite interpolant of the step and the integration restarts there:
+ * in the direction of the driving moment if it overcomes static friction,
+ * otherwise the pendulum sticks until it does (drive)
+ */
+#define SOL_EVENTS_MAX 64 // velocity zeros per frame, more is chattering
+#define SOL_BISECTIONS 48
+#define SOL_STICK_SAMPLES 16 // per drive period while sticking
 
-	gsl_set_error_handler((gsl_error_handler_t*) sol_gsl_error_handler);
+static int chattering = 0; // warned once per run
 
-	conf->temp.driver = gsl_odeiv2_driver_alloc_y_new(&(conf->model.equation), conf->solver.stepper,
-		conf->solver.initialstep, conf->solver.abserr, conf->solver.relerr);
+/* at rest: stick or slip in the direction of the driving moment */
+static void stick_or_slip (pendulum_configuration* conf, double time, const double state[]) {
 
-	if (simflag)
-		return -1;
+	const double moment = moment_driving(time, state, conf);
+	conf->temp.stick = fabs(moment) <= conf->bearing.friction_static;
+	conf->temp.friction_direction = conf->temp.stick ? 0.0 : copysign(1.0, moment);
+}
+
+/* velocity at "tau" (0..1) of a step "dt" from the values and accelerations at both ends */
+static inline double hermite (double tau, double dt, const double v[2], const double a[2]) {
+	const double tau2 = tau * tau, tau3 = tau2 * tau;
+	return (2.0 * tau3 - 3.0 * tau2 + 1.0) * v[0] + (tau3 - 2.0 * tau2 + tau) * dt * a[0]
+		+ (- 2.0 * tau3 + 3.0 * tau2) * v[1] + (tau3 - tau2) * dt * a[1];
+}
+
+static int solve_stick_slip (pendulum_configuration* conf, double t_final) {
+
+	gsl_odeiv2_driver* driver = conf->temp.driver;
+	const gsl_odeiv2_system* system = &(conf->model.equation);
+	unsigned int events = 0, n;
+	int err;
+
+	while ( t < t_final ) {
+
+		// at rest until the driving moment overcomes static friction, sampled over the frame
+		// so a breakaway that drops back before its end is not missed, then bisected
+		if ( conf->temp.stick ) {
+			const double sample = conf->drive.type != PAR_DRIVE_NONE && conf->drive.omega > 0.0 ?
+				2.0 * M_PI / conf->drive.omega / SOL_STICK_SAMPLES : t_final - t;
+			double lower = t, upper = t;
+			while ( upper < t_final ) {
+				upper = fmin(lower + sample, t_final);
+				if ( fabs(moment_driving(upper, y, conf)) > conf->bearing.friction_static )
+					break;
+				lower = upper;
+			}
+			if ( lower >= t_final ) {
+				t = t_final;
+				break;
+			}
+			for ( n = 0; n < SOL_BISECTIONS; n++ ) {
+				const double middle = 0.5 * (lower + upper);
+				if ( fabs(moment_driving(middle, y, conf)) <= conf->bearing.friction_static )
+					lower = middle;
+				else
+					upper = middle;
+			}
+			t = upper;
+			stick_or_slip(conf, t, y);
+			gsl_odeiv2_driver_reset(driver);
+			continue;
+		}
+
+		const double t_step = t;
+		double y_step[2] = { y[0], y[1] }, dydt_step[2], dydt[2];
+		system->function(t_step, y_step, dydt_step, system->params);
+
+		err = gsl_odeiv2_evolve_apply(driver->e, driver->c, driver->s, system, &t, t_final, &(driver->h), y);
+		if ( err != GSL_SUCCESS )
+			return err;
+		if ( driver->h > driver->hmax )
+			driver->h = driver->hmax;
+
+		if ( conf->temp.friction_direction * y[1] >= 0.0 )
+			continue;
+
+		// the velocity changed its sign within the step, locate the zero and restart from there
+
+		const double dt = t - t_step;
+		system->function(t, y, dydt, system->params);
+		const double velocity[2] = { y_step[1], y[1] }, acceleration[2] = { dydt_step[1], dydt[1] };
+		double lower = 0.0, upper = 1.0;
+		for ( n = 0; n < SOL_BISECTIONS; n++ ) {
+			const double middle = 0.5 * (lower + upper);
+			if ( conf->temp.friction_direction * hermite(middle, dt, velocity, acceleration) >= 0.0 )
+				lower = middle;
+			else
+				upper = middle;
+		}
+
+		t = t_step;
+		y[0] = y_step[0];
+		y[1] = y_step[1];
+		gsl_odeiv2_driver_reset(driver);
+		if ( lower > 0.0 ) {
+			err = gsl_odeiv2_evolve_apply_fixed_step(driver->e, NULL, driver->s, system, &t, lower * dt, y);
+			if ( err != GSL_SUCCESS )
+				return err;
+		}
+		y[1] = 0.0;
+
+		stick_or_slip(conf, t, y);
+		gsl_odeiv2_driver_reset(driver);
+
+		// chattering about zero velocity, at rest for the rest of the frame so the
+		// run keeps up with the clock, the next frame decides again whether it slips
+		if ( ++events > SOL_EVENTS_MAX ) {
+			if ( !chattering )
+				ui_print("stick-slip chattering at %.2f s, holding at rest per frame\n\r", t);
+			chattering = 1;
+			conf->temp.stick = 1;
+			conf->temp.friction_direction = 0.0;
+			t = t_final;
+			break;
+		}
+	}
+
+	return GSL_SUCCESS;
+}
+
+/* the state of the frame for display and other processes */
+static void frame_state (pendulum_configuration* conf) {
+
+	const unsigned int dimension = conf->model.state_dimension;
+	unsigned int i;
+	for ( i = 0; i < dimension; i++ )
+		conf->temp.state[i] = y[i];
+
+	conf->temp.time = t;
+	conf->temp.angle = y[0];
+	conf->temp.velocity = y[dimension/2];
+
+	// energy error, a measure of the accuracy of conservative models
+	conf->temp.energy = energy(y, conf);
+	if ( conf->model.conservative && conf->temp.energy_initial != 0.0 ) {
+		conf->temp.energy_error = (conf->temp.energy - conf->temp.energy_initial) / fabs(conf->temp.energy_initial);
+		if ( fabs(conf->temp.energy_error) > conf->temp.energy_error_max )
+			conf->temp.energy_error_max = fabs(conf->temp.energy_error);
+	}
+}
+
+/* checkpoints (see sol_seek) */
+
+static void checkpoint_record (pendulum_configuration* conf) {
+
+	const long slot = (long) floor(t / SOL_CHECKPOINT_PERIOD);
+	if ( slot < 0 )
+		return;
+
+	sol_checkpoint* checkpoint = &checkpoints[slot % SOL_CHECKPOINTS];
+	if ( checkpoint->slot == slot )
+		return;
+
+	checkpoint->slot = slot;
+	checkpoint->time = t;
+	memcpy(checkpoint->state, y, conf->model.equation.dimension * sizeof(double));
+	checkpoint->step = conf->temp.driver != NULL ? conf->temp.driver->h : 0.0;
+	checkpoint->friction_direction = conf->temp.friction_direction;
+	checkpoint->stick = conf->temp.stick;
+	checkpoint->lyapunov_sum[0] = conf->temp.lyapunov_sum[0];
+	checkpoint->lyapunov_sum[1] = conf->temp.lyapunov_sum[1];
+}
+
+/* the internal state of the stepper (e.g. adams history) is not kept, it restarts with the step size */
+static void checkpoint_restore (pendulum_configuration* conf, const sol_checkpoint* checkpoint) {
+
+	t = checkpoint->time;
+	memcpy(y, checkpoint->state, conf->model.equation.dimension * sizeof(double));
+	conf->temp.friction_direction = checkpoint->friction_direction;
+	conf->temp.stick = checkpoint->stick;
+	conf->temp.lyapunov_sum[0] = checkpoint->lyapunov_sum[0];
+	conf->temp.lyapunov_sum[1] = checkpoint->lyapunov_sum[1];
+	if ( t > 0.0 ) {
+		conf->temp.lyapunov[0] = conf->temp.lyapunov_sum[0] / t;
+		conf->temp.lyapunov[1] = conf->temp.lyapunov_sum[1] / t;
+	}
+
+	if ( conf->temp.driver != NULL )
+		gsl_odeiv2_driver_reset_hstart(conf->temp.driver,
+			checkpoint->step > 0.0 ? checkpoint->step : conf->solver.initialstep);
+}
+
+/* the driver is kept between runs, allocate only if the stepper or the model changed */
+static int driver_init (pendulum_configuration* conf) {
+
+	if ( conf->temp.driver != NULL &&
+			( conf->temp.driver_stepper != conf->solver.stepper ||
+			  conf->temp.driver_dimension != conf->model.equation.dimension ) )
+		sol_solver_free(conf);
+
+	if ( conf->temp.driver == NULL ) {
+		conf->temp.driver = gsl_odeiv2_driver_alloc_y_new(&(conf->model.equation), conf->solver.stepper,
+			conf->solver.initialstep, conf->solver.abserr, conf->solver.relerr);
+
+		if ( simflag || conf->temp.driver == NULL ) {
+			conf->temp.driver = NULL;
+			return -1;
+		}
+
+		conf->temp.driver_stepper = conf->solver.stepper;
+		conf->temp.driver_dimension = conf->model.equation.dimension;
+	} else {
+		if ( gsl_odeiv2_control_init(conf->temp.driver->c, conf->solver.abserr, conf->solver.relerr, 1.0, 0.0) != GSL_SUCCESS ||
+				gsl_odeiv2_driver_reset_hstart(conf->temp.driver, conf->solver.initialstep) != GSL_SUCCESS ) {
+			ui_print("failed to reset solver!\n\r");
+			return -1;
+		}
+	}
 
 	if ( gsl_odeiv2_driver_set_hmax(conf->temp.driver, conf->solver.maxstep) != GSL_SUCCESS ) {
 		ui_print("failed to set max step!\n\r");
 		return -1;
 	}
 
-	y[0] = conf->temp.angle;
-	y[1] = 0.0;
+	return 0;
+}
+
+/* this function is called before the simulation */
+int sol_solver_init (pendulum_configuration* conf) {
+
+	gsl_set_error_handler((gsl_error_handler_t*) sol_gsl_error_handler);
+
+	// symplectic steppers do without the driver
+	if ( !conf->solver.symplectic && driver_init(conf) )
+		return -1;
+
+	// angles (of all links) first, then the velocities
+	const unsigned int n = conf->model.state_dimension / 2;
+	unsigned int i;
+	for ( i = 0; i < n; i++ ) {
+		y[i] = i == 0 ? conf->temp.angle : conf->links.initial_angle[i];
+		y[n+i] = 0.0;
+	}
+	for ( i = 0; i < 2*n; i++ )
+		conf->temp.state[i] = y[i];
 	t = 0.0;
+	conf->temp.time = 0.0;
+	conf->temp.velocity = 0.0;
+
+	// tangent vectors follow the state (see rhs_tangent)
+	if ( conf->model.lyapunov )
+		sol_lyapunov_init(conf, y + 2*n);
+
+	// released at rest, constant friction follows the driving moment
+	conf->temp.friction_direction = 0.0;
+	conf->temp.stick = 0;
+	if ( conf->model.stick_slip )
+		stick_or_slip(conf, t, y);
+
+	conf->temp.energy = conf->temp.energy_initial = energy(y, conf);
+	conf->temp.energy_error = conf->temp.energy_error_max = 0.0;
+
+	// a new run at normal speed, its first checkpoint is the initial condition
+	time_scale = 1.0;
+	chattering = 0;
+	for ( i = 0; i < SOL_CHECKPOINTS; i++ )
+		checkpoints[i].slot = -1;
+	checkpoint_record(conf);
 
 	return 0;
 }
 
+/*
+ * continue the run at "time" (simulated), from the latest checkpoint not
+ * after it (or the current state if that is closer), before the oldest
+ * checkpoint the run continues there, the clock is anchored to the new time
+ */
+int sol_seek (pendulum_configuration* conf, double time) {
+
+	const sol_checkpoint* best = NULL;
+	const sol_checkpoint* oldest = NULL;
+	unsigned int i;
+
+	for ( i = 0; i < SOL_CHECKPOINTS; i++ ) {
+		const sol_checkpoint* checkpoint = &checkpoints[i];
+		if ( checkpoint->slot < 0 )
+			continue;
+		if ( checkpoint->time <= time && (best == NULL || checkpoint->time > best->time) )
+			best = checkpoint;
+		if ( oldest == NULL || checkpoint->time < oldest->time )
+			oldest = checkpoint;
+	}
+
+	if ( oldest == NULL )
+		return -1;
+	if ( best == NULL ) {
+		best = oldest;
+		time = oldest->time;
+	}
+
+	if ( !(t <= time && t >= best->time) )
+		checkpoint_restore(conf, best);
+
+	// frame by frame, fixed steps keep their size
+	const double frame = t_frame_duration > 0.0 ? t_frame_duration : 1.0 / 60.0;
+	frame_state(conf);
+	while ( time > t && !simflag ) {
+		t_sol_final = fmin(t + frame, time);
+		sol_solve_next_frame(conf);
+	}
+
+	sol_set_time_scale(time_scale);
+
+	return simflag ? -1 : 0;
+}
+
 void sol_solve_next_frame (pendulum_configuration* conf) {
 	
 	int err;
 
-	if ( conf->solver.adaptive )
+	// the pendulum is not moving yet (start delayed, see sol_set_start_time)
+	if ( t_sol_final <= t )
+		return;
+
+	if ( conf->solver.symplectic )
+		err = sol_symplectic_fixed(&(conf->model.equation), conf->solver.symplectic, &t,
+			y, (t_sol_final-t) / conf->solver.substeps, conf->solver.substeps);
+	else if ( conf->model.stick_slip )
+		err = solve_stick_slip(conf, t_sol_final);
+	else if ( conf->solver.adaptive )
 		err = gsl_odeiv2_driver_apply(conf->temp.driver, &t, t_sol_final, y);
 	else
 		err = gsl_odeiv2_driver_apply_fixed_step(conf->temp.driver, &t,
 			(t_sol_final-t) / conf->solver.substeps, conf->solver.substeps, y);
 
 	if ( err != GSL_SUCCESS ) {
-		char errormsg[256];
-		snprintf(errormsg, sizeof(errormsg), "gsl step failed %d: %s", err,  gsl_strerror(err) );
-		ui_print(errormsg);
+		ui_print("gsl step failed %d: %s", err, gsl_strerror(err));
 		simflag = 1;
 		return;
 	}
 
-	conf->temp.angle = y[0];
+	frame_state(conf);
+
+	// renormalise the tangent vectors once per frame, the driver restarts from the new state
+	if ( conf->model.lyapunov ) {
+		sol_lyapunov_renormalize(conf, y + conf->model.state_dimension, t);
+		gsl_odeiv2_driver_reset(conf->temp.driver);
+	}
+
+	checkpoint_record(conf);
 }
 
-int sol_solver_terminate (pendulum_configuration* conf) {
+/* continue the single pendulum from a corrected state at "time" (see est.c) */
+void sol_set_state (pendulum_configuration* conf, double time, double angle, double velocity) {
+
+	t = time;
+	y[0] = conf->temp.state[0] = conf->temp.angle = angle;
+	y[1] = conf->temp.state[1] = conf->temp.velocity = velocity;
+	conf->temp.time = time;
+
+	// constant friction follows the new velocity
+	if ( conf->model.stick_slip ) {
+		if ( velocity != 0.0 ) {
+			conf->temp.stick = 0;
+			conf->temp.friction_direction = copysign(1.0, velocity);
+		} else {
+			stick_or_slip(conf, t, y);
+		}
+	}
 
-	if ( gsl_odeiv2_driver_reset(conf->temp.driver) != GSL_SUCCESS )
-		fprintf(stderr,"solver not reset correctly!\n\r");
+	if ( conf->temp.driver != NULL )
+		gsl_odeiv2_driver_reset(conf->temp.driver);
+}
 
-	/* whoot?
-	if ( gsl_odeiv2_driver_free(conf->temp.driver) != GSL_SUCCESS ) {
-		fprintf(stderr,"solver not freed correctly!\n\r");
-		return -1;
+/* lyapunov exponents from tangent vectors (benettin, see lya.c) */
+
+/* tangent vectors = identity, no accumulated growth */
+void sol_lyapunov_init (pendulum_configuration* conf, double tangent[]) {
+
+	tangent[0] = 1.0; tangent[1] = 0.0;
+	tangent[2] = 0.0; tangent[3] = 1.0;
+
+	conf->temp.lyapunov_sum[0] = conf->temp.lyapunov_sum[1] = 0.0;
+	conf->temp.lyapunov[0] = conf->temp.lyapunov[1] = 0.0;
+}
+
+/* orthonormalise the tangent vectors (columns) and update the exponents at "time" */
+void sol_lyapunov_renormalize (pendulum_configuration* conf, double tangent[], double time) {
+
+	double* v1 = tangent;
+	double* v2 = tangent + 2;
+
+	// a blown up tangent vector has no exponents
+	if ( !fm_finite(v1[0]) || !fm_finite(v1[1]) || !fm_finite(v2[0]) || !fm_finite(v2[1]) ) {
+		conf->temp.lyapunov[0] = conf->temp.lyapunov[1] = NAN;
+		return;
 	}
-	*/
 
-	gsl_odeiv2_driver_free(conf->temp.driver);
+	const double r11 = hypot(v1[0], v1[1]);
+	if ( !(r11 > 0.0) || !fm_finite(r11) )
+		return;
+	v1[0] /= r11; v1[1] /= r11;
+
+	const double r12 = v1[0] * v2[0] + v1[1] * v2[1];
+	v2[0] -= r12 * v1[0]; v2[1] -= r12 * v1[1];
+
+	const double r22 = hypot(v2[0], v2[1]);
+	if ( !(r22 > 0.0) || !fm_finite(r22) )
+		return;
+	v2[0] /= r22; v2[1] /= r22;
+
+	conf->temp.lyapunov_sum[0] += log(r11);
+	conf->temp.lyapunov_sum[1] += log(r22);
+
+	if ( time > 0.0 ) {
+		conf->temp.lyapunov[0] = conf->temp.lyapunov_sum[0] / time;
+		conf->temp.lyapunov[1] = conf->temp.lyapunov_sum[1] / time;
+	}
+}
+
+/*
+ * variants of the numeric kernels, the best one the cpu supports is
+ * selected at startup, the generic build (last) runs everywhere
+ */
+#define SOL_KERNELS_ENTRY(variant, features) { #variant, features, rhs_##variant, jac_##variant, \
+	rhs_linear_##variant, jac_linear_##variant, rhs_links_##variant, rk4_fixed_##variant, symplectic_fixed_##variant }
+
+#if defined(__arm__)
+#define SOL_KERNEL_NEON(name) name##_neon
+SOL_KERNELS_DECLARE(SOL_KERNEL_NEON)
+#elif defined(__x86_64__)
+#define SOL_KERNEL_SSE4(name) name##_sse4
+#define SOL_KERNEL_AVX2(name) name##_avx2
+SOL_KERNELS_DECLARE(SOL_KERNEL_SSE4)
+SOL_KERNELS_DECLARE(SOL_KERNEL_AVX2)
+#endif
+
+static const sol_kernel_table kernels[] = {
+#if defined(__arm__)
+	SOL_KERNELS_ENTRY(neon, CPU_NEON),
+#elif defined(__x86_64__)
+	SOL_KERNELS_ENTRY(avx2, CPU_AVX2),
+	SOL_KERNELS_ENTRY(sse4, CPU_SSE4),
+#endif
+	{ "generic", 0, rhs, jac, rhs_linear, jac_linear, rhs_links, rk4_fixed, symplectic_fixed }
+};
+
+#define SOL_KERNELS_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+const sol_kernel_table* sol_kernels = &kernels[SOL_KERNELS_COUNT - 1];
+
+/* before the first configuration is loaded, returns the name of the variant */
+const char* sol_kernels_select () {
+
+	const unsigned int features = cpu_features();
+	unsigned int i;
+
+	for ( i = 0; i < SOL_KERNELS_COUNT; i++ )
+		if ( (kernels[i].features & features) == kernels[i].features ) {
+			sol_kernels = &kernels[i];
+			break;
+		}
+
+	return sol_kernels->name;
+}
+
+/* batch integrators without driver, see sol-fixed.c */
+int sol_rk4_fixed (const gsl_odeiv2_system* system, double* time, double state[], double h, unsigned int steps) {
+	return sol_kernels->rk4_fixed(system, time, state, h, steps);
+}
+
+int sol_symplectic_fixed (const gsl_odeiv2_system* system, unsigned int order, double* time, double state[],
+		double h, unsigned int steps) {
+	return sol_kernels->symplectic_fixed(system, order, time, state, h, steps);
+}
+
+/* end of a run, the driver is kept for the next one */
+int sol_solver_terminate (pendulum_configuration* conf) {
+
+	conf->temp.friction_direction = 0.0;
+	conf->temp.stick = 0;
+
+	if ( conf->temp.driver == NULL )
+		return 0;
+
+	if ( gsl_odeiv2_driver_reset(conf->temp.driver) != GSL_SUCCESS )
+		fprintf(stderr,"solver not reset correctly!\n\r");
 
 	return 0;
 }
 
+/* end of the session */
+void sol_solver_free (pendulum_configuration* conf) {
 
+	if ( conf->temp.driver == NULL )
+		return;
+
+	gsl_odeiv2_driver_free(conf->temp.driver);
+	conf->temp.driver = NULL;
+	conf->temp.driver_stepper = NULL;
+	conf->temp.driver_dimension = 0;
+}
@@ -16,23 +16,79 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <time.h>
 #include <gsl/gsl_odeiv2.h>
 
 #include "par.h"
 
-int rhs (double t, const double y[], double dydt[], void *params);
-int jac (double t, const double y[], double *dfdy, double dfdt[], void *params);
-int rhs_linear (double t, const double y[], double dydt[], void *params);
-int jac_linear (double t, const double y[], double *dfdy, double dfdt[], void *params);
+/*
+ * the numeric kernels (sol-equations.c, sol-fixed.c) are built once more for
+ * every cpu variant in the makefile, with SOL_VARIANT appended to their names
+ */
+#ifdef SOL_VARIANT
+#define SOL_KERNEL(name) SOL_KERNEL_NAME(name, SOL_VARIANT)
+#else
+#define SOL_KERNEL(name) name
+#endif
+#define SOL_KERNEL_NAME(name, variant) SOL_KERNEL_PASTE(name, variant)
+#define SOL_KERNEL_PASTE(name, variant) name##_##variant
+
+#define SOL_KERNELS_DECLARE(K) \
+int K(rhs) (double t, const double y[], double dydt[], void *params); \
+int K(jac) (double t, const double y[], double *dfdy, double dfdt[], void *params); \
+int K(rhs_linear) (double t, const double y[], double dydt[], void *params); \
+int K(jac_linear) (double t, const double y[], double *dfdy, double dfdt[], void *params); \
+int K(rhs_links) (double t, const double y[], double dydt[], void *params); \
+int K(rk4_fixed) (const gsl_odeiv2_system* system, double* time, double state[], double h, unsigned int steps); \
+int K(symplectic_fixed) (const gsl_odeiv2_system* system, unsigned int order, double* time, double state[], \
+	double h, unsigned int steps);
+
+SOL_KERNELS_DECLARE(SOL_KERNEL)
+int SOL_KERNEL(rhs_tangent) (double t, const double y[], double dydt[], void *params);
+double SOL_KERNEL(energy) (const double y[], pendulum_configuration* data);
+double SOL_KERNEL(moment_driving) (double t, const double y[], pendulum_configuration* data);
+
+/* one variant of the kernels, the model and the solvers call them through sol_kernels */
+typedef struct {
+	const char* name;
+	unsigned int features; // needed, see cpu.h
+	int (*rhs) (double t, const double y[], double dydt[], void *params);
+	int (*jac) (double t, const double y[], double *dfdy, double dfdt[], void *params);
+	int (*rhs_linear) (double t, const double y[], double dydt[], void *params);
+	int (*jac_linear) (double t, const double y[], double *dfdy, double dfdt[], void *params);
+	int (*rhs_links) (double t, const double y[], double dydt[], void *params);
+	int (*rk4_fixed) (const gsl_odeiv2_system* system, double* time, double state[], double h, unsigned int steps);
+	int (*symplectic_fixed) (const gsl_odeiv2_system* system, unsigned int order, double* time, double state[],
+		double h, unsigned int steps);
+} sol_kernel_table;
+
+extern const sol_kernel_table* sol_kernels;
 
 
 //double t_sol_final, t_frame_duration; // dont move to data/params!
 
 int sol_solver_init(pendulum_configuration* conf);
 int sol_solver_terminate(pendulum_configuration* conf);
+void sol_solver_free(pendulum_configuration* conf);
+const char* sol_kernels_select ();
+int sol_rk4_fixed (const gsl_odeiv2_system* system, double* time, double state[], double h, unsigned int steps);
+int sol_symplectic_fixed (const gsl_odeiv2_system* system, unsigned int order, double* time, double state[],
+	double h, unsigned int steps);
+void sol_set_state (pendulum_configuration* conf, double time, double angle, double velocity);
+void sol_lyapunov_init (pendulum_configuration* conf, double tangent[]);
+void sol_lyapunov_renormalize (pendulum_configuration* conf, double tangent[], double time);
 void sol_save_start_time();
+void sol_set_start_time (const struct timespec* start, double delay);
+void sol_get_start_time (struct timespec* start);
 void sol_debug_time ();
 void sol_solve_next_frame(pendulum_configuration* conf);
 void sol_calculate_frame_duration ();
+void sol_set_frame_duration (double duration);
+double sol_get_frame_duration ();
 void sol_calculate_time_next_frame ();
+void sol_set_time_next_frame (double t_final);
 void sol_debug_time_integrity();
+double sol_frame_lateness ();
+void sol_set_time_scale (double scale);
+double sol_get_time_scale ();
+int sol_seek (pendulum_configuration* conf, double time);
@@ -18,15 +18,26 @@
 
 #include <fcntl.h>
 #include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
 #include <cdk_test.h>
 
 #include "ui.h"
 #include "gl.h"
 #include "par.h"
+#include "sol.h"
 
 #define UI_ANGLE_DELTA 0.02f
 #define UI_ANGLE_DELTA_FINE 0.001f
 #define UI_LEN_DELTA 0.01f
+#define UI_SEEK_DELTA 2.0 // s per arrow key while simulating
+
+/* time scales while simulating (up, down), pause and continue (p) */
+static const double ui_time_scales[] = { 0.0, 0.1, 1.0, 4.0 };
+#define UI_TIME_SCALES (sizeof(ui_time_scales) / sizeof(ui_time_scales[0]))
+static double ui_time_scale_resume = 1.0;
+#define UI_LOG_SLOTS 64 // messages waiting for ui_flush
+#define UI_LOG_LENGTH 128
 
 CDKSCREEN *cdkscreen = 0;
 CDKLABEL* textwidget = 0;
@@ -34,16 +45,33 @@ CDKLABEL* textwidget2 = 0;
 boolean functionKey;
 CDKSWINDOW *commandOutput = 0;
 
+/* message ring, see ui_print */
+typedef struct {
+	atomic_uint sequence;
+	char text[UI_LOG_LENGTH];
+} ui_log_record;
+
+static ui_log_record log_ring[UI_LOG_SLOTS];
+static atomic_uint log_head;
+static atomic_uint log_dropped;
+static unsigned int log_tail;
+static char log_last[UI_LOG_LENGTH];
+static unsigned int log_repeated;
+
 int ui_listen_config (pendulum_configuration* conf, volatile sig_atomic_t* stopflag) {
 
 	//drawCDKLabel(textwidget2, FALSE);
 	drawCDKLabel(textwidget, FALSE);
 
+	const int input = getchCDKObject(ObjOf(textwidget), &functionKey);
+	if ( input == ERR )
+		return UI_INPUT_NONE;
+
 	char* configname = "conf-default";
-	switch ( (chtype) getchCDKObject(ObjOf(textwidget), &functionKey) ) {
+	switch ( (chtype) input ) {
 		case 4:
 			*stopflag = 1;
-			return 0;
+			return UI_INPUT_KEY;
 		case '1':
 			configname = "conf-default";
 			break;
@@ -68,81 +96,132 @@ int ui_listen_config (pendulum_configuration* conf, volatile sig_atomic_t* stopf
 		case '8':
 			configname = "conf-water-damped";
 			break;
+		case '9':
+			configname = "conf-double-pendulum";
+			break;
+		case '0':
+			configname = "conf-triple-pendulum";
+			break;
 		default:
-			return 0;
+			return UI_INPUT_KEY;
 	}
 
 	par_load_configuration((const char*) configname, conf, PAR_NOT_RESET);
-	return 1;
+	return UI_INPUT_START;
 }
 
-void ui_listen_simulation (pendulum_configuration* conf, volatile sig_atomic_t* simflag) {
+int ui_listen_simulation (pendulum_configuration* conf, volatile sig_atomic_t* simflag) {
 	int input = getchCDKObject(ObjOf(textwidget), &functionKey);
-	if ( input == 343 || input == 32 || input == 27 )
+	if ( input == ERR )
+		return UI_INPUT_NONE;
+	else if ( input == 343 || input == 32 || input == 27 )
 		*simflag = 1;
 	else if ( input == 118 )
 		gl_toggle_alpha(conf);
+	else if ( input == 116 )
+		gl_toggle_trail(conf);
+	else if ( input == 103 )
+		gl_toggle_phase(conf);
+	else if ( input == 112 || input == 259 || input == 258 ) {
+		// pause and continue (p), faster (up), slower (down)
+		const double scale = sol_get_time_scale();
+		unsigned int i = 0;
+		while ( i + 1 < UI_TIME_SCALES && ui_time_scales[i] < scale )
+			i++;
+		double next = scale;
+		if ( input == 112 ) {
+			if ( scale != 0.0 )
+				ui_time_scale_resume = scale;
+			next = scale != 0.0 ? 0.0 : ui_time_scale_resume;
+		} else if ( input == 259 && i + 1 < UI_TIME_SCALES ) {
+			next = ui_time_scales[i + 1];
+		} else if ( input == 258 && i > 0 ) {
+			next = ui_time_scales[i - 1];
+		}
+		sol_set_time_scale(next);
+		ui_print("time scale %gx at %.2f s\r\n", next, conf->temp.time);
+		return UI_INPUT_TIME;
+	} else if ( input == 260 || input == 261 ) {
+		// seek back (left) and forward (right)
+		if ( sol_seek(conf, conf->temp.time + (input == 260 ? -UI_SEEK_DELTA : UI_SEEK_DELTA)) )
+			ui_print("seek failed\r\n");
+		else
+			ui_print("continuing at %.2f s\r\n", conf->temp.time);
+		gl_trail_reset(conf);
+		return UI_INPUT_TIME;
+	}
+	return UI_INPUT_KEY;
 }
 
-void ui_listen_setup (pendulum_configuration* conf, volatile sig_atomic_t* simflag, volatile sig_atomic_t* setupflag) {
+int ui_listen_setup (pendulum_configuration* conf, volatile sig_atomic_t* simflag, volatile sig_atomic_t* setupflag) {
 	int input = getchCDKObject(ObjOf(textwidget), &functionKey);
 	switch ( input ) {
 		// transparency
 		case 118:
 			gl_toggle_alpha(conf);
-			return;
+			return UI_INPUT_REDRAW;
+		// trail and phase portrait (t, g)
+		case 116:
+			gl_toggle_trail(conf);
+			return UI_INPUT_REDRAW;
+		case 103:
+			gl_toggle_phase(conf);
+			return UI_INPUT_REDRAW;
 		// rodlength (+, -)
 		case 43:
 			// plus
 			gl_update_geometry(UI_LEN_DELTA, 0.0f, 0.0f, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		case 45:
 			// minus
 			gl_update_geometry(-UI_LEN_DELTA, 0.0f, 0.0f, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		// suspension position (w a s d)
 		case 119:
 			// up
 			gl_update_geometry(0.0f, 0.0f, UI_LEN_DELTA, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		case 115:
 			// down
 			gl_update_geometry(0.0f, 0.0f, -UI_LEN_DELTA, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		case 100:
 			// right
 			gl_update_geometry(0.0f, UI_LEN_DELTA, 0.0f, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		case 97:
 			// left
 			gl_update_geometry(0.0f, -UI_LEN_DELTA, 0.0f, conf);
-			return;
+			return UI_INPUT_REDRAW;
 		// starting angle 
 		case 260:
 			// left
 			conf->temp.angle = conf->temp.angle - UI_ANGLE_DELTA;
-			return;
+			return UI_INPUT_REDRAW;
 		case 261:
 			// right
 			conf->temp.angle = conf->temp.angle + UI_ANGLE_DELTA;
-			return;
+			return UI_INPUT_REDRAW;
 		// starting angle (fine tune) TODO
 
 		// end simulation (ESC)
 		case 27:
 			*simflag = 1;
-			return;
+			return UI_INPUT_KEY;
 		// finish setup (ENTER or SPACE)
 		case 343:
 			*setupflag = 1;
-			return;
+			return UI_INPUT_KEY;
 		case 32:
 			*setupflag = 1;
-			return;
+			return UI_INPUT_KEY;
+		// no input
+		case ERR:
+			return UI_INPUT_NONE;
 		// default
 		default:
 			//if (input > 0) printf("%i\n",input);
-			return;
+			return UI_INPUT_KEY;
 	}	
 }
 
@@ -160,7 +239,7 @@ int ui_init () {
 	/* Start CDK Colors. */
 	initCDKColor();
 
-	const char *mesg[12];
+	const char *mesg[14];
 	mesg[0] = "<L>A) Choose configuration/parameter presetting:";
 	mesg[1] = "<L><#HL(70)>";
 	mesg[2] = "<L>Press </B/32>1<!B!32> for </B/32>default";
@@ -171,24 +250,36 @@ int ui_init () {
 	mesg[7] = "<L>Press </B/32>6<!B!32> for </B/32>Jupiter - damped";
 	mesg[8] = "<L>Press </B/32>7<!B!32> for </B/32>Moon - undamped";
 	mesg[9] = "<L>Press </B/32>8<!B!32> for </B/32>Water - damped";
-	mesg[10] = "<L><#HL(70)>";
-	mesg[11] = "<L>Press CTRL+D to quit";
-	textwidget = newCDKLabel(cdkscreen, RIGHT, TOP, (CDK_CSTRING2) mesg, 12, FALSE, FALSE);
+	mesg[10] = "<L>Press </B/32>9<!B!32> for </B/32>Double pendulum";
+	mesg[11] = "<L>Press </B/32>0<!B!32> for </B/32>Triple pendulum";
+	mesg[12] = "<L><#HL(70)>";
+	mesg[13] = "<L>Press CTRL+D to quit";
+	textwidget = newCDKLabel(cdkscreen, RIGHT, TOP, (CDK_CSTRING2) mesg, 14, FALSE, FALSE);
 
-	const char *mesg2[7];
+	const char *mesg2[8];
 	mesg2[0] = "<L>B) Adjust settings:";
 	mesg2[1] = "<L><#HL(70)>";
 	mesg2[2] = "<L>Use </B/24>w, a, s, d<!B!24> to change the </B/24>position of the pivot";
 	mesg2[3] = "<L>Use </B/24>+, -<!B!24> to change the </B/24>virtual length of the pendulum";
 	mesg2[4] = "<L>Use </B/24>left, right<!B!24> to change the </B/24>initial angle";
 	mesg2[5] = "<L>Use </B/24>v<!B!24> to </B/24>toggle text display";
-	mesg2[6] = "<L><#HL(70)>";
-	textwidget2 = newCDKLabel(cdkscreen, RIGHT, CENTER, (CDK_CSTRING2) mesg2, 7, FALSE, FALSE);
+	mesg2[6] = "<L>Use </B/24>t, g<!B!24> to toggle </B/24>trail and phase portrait";
+	mesg2[7] = "<L><#HL(70)>";
+	textwidget2 = newCDKLabel(cdkscreen, RIGHT, CENTER, (CDK_CSTRING2) mesg2, 8, FALSE, FALSE);
 
 	commandOutput = newCDKSwindow(cdkscreen, RIGHT, BOTTOM, 10, 70, "output:", 9, TRUE, FALSE);
 
 	refreshCDKScreen(cdkscreen);
 
+	unsigned int i;
+	for ( i = 0; i < UI_LOG_SLOTS; i++ )
+		atomic_init(&log_ring[i].sequence, i);
+	atomic_init(&log_head, 0);
+	atomic_init(&log_dropped, 0);
+	log_tail = 0;
+	log_last[0] = '\0';
+	log_repeated = 0;
+
 	if ( fcntl(0, F_SETFL, O_NONBLOCK) ) {
 		fprintf(stderr, "Could not set input mode to non-blocking!\n\r");
 		return -1;
@@ -199,6 +290,7 @@ int ui_init () {
 
 
 void ui_terminate () {
+	ui_flush(UI_LOG_SLOTS);
 	destroyCDKLabel(textwidget);
 	destroyCDKLabel(textwidget2);
 	destroyCDKSwindow(commandOutput);
@@ -210,16 +302,101 @@ void ui_clear () {
 	cleanCDKSwindow(commandOutput);
 }
 
+/*
+ * messages are not written to the screen by ui_print (it is called from the
+ * simulation loop and the gsl error handler), they are formatted into a fixed
+ * ring of records and drawn later by ui_flush
+ *
+ * the ring is a bounded lock-free multi producer / single consumer queue:
+ * producers claim a slot by advancing "head", every slot has a sequence
+ * number telling whether it is free (== position) or filled (== position + 1)
+ */
+
 void ui_print (const char *format, ...) {
-	char msg[256];
 	va_list arglist;
 
+	// no console user interface (e.g. video export)
+	if ( commandOutput == 0 ) {
+		va_start(arglist, format);
+		vfprintf(stderr, format, arglist);
+		va_end(arglist);
+		return;
+	}
+
+	// claim a slot, drop the message if the ring is full
+
+	unsigned int position = atomic_load_explicit(&log_head, memory_order_relaxed);
+	ui_log_record* record;
+	for (;;) {
+		record = &log_ring[position % UI_LOG_SLOTS];
+		const unsigned int sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+		const int difference = (int) (sequence - position);
+		if ( difference == 0 ) {
+			if ( atomic_compare_exchange_weak_explicit(&log_head, &position, position + 1,
+					memory_order_relaxed, memory_order_relaxed) )
+				break;
+		} else if ( difference < 0 ) {
+			atomic_fetch_add_explicit(&log_dropped, 1, memory_order_relaxed);
+			return;
+		} else {
+			position = atomic_load_explicit(&log_head, memory_order_relaxed);
+		}
+	}
+
 	va_start(arglist, format);
-	vsnprintf(msg, sizeof(msg), format, arglist);
+	vsnprintf(record->text, sizeof(record->text), format, arglist);
 	va_end(arglist);
 
+	atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+}
+
+/* write how often the last message was held back after it was drawn */
+static void flush_repeated () {
+
+	if ( log_repeated == 0 )
+		return;
+
+	char msg[UI_LOG_LENGTH + 32];
+	snprintf(msg, sizeof(msg), "%s (repeated %u times)", log_last, log_repeated);
 	jumpToLineCDKSwindow(commandOutput, BOTTOM);
 	addCDKSwindow(commandOutput, msg, BOTTOM);
+	log_repeated = 0;
 }
 
+/* draw pending messages (at most "max"), a message repeating the last one word for word is counted */
+void ui_flush (unsigned int max) {
+
+	if ( commandOutput == 0 )
+		return;
+
+	unsigned int count;
+	for ( count = 0; count < max; count++ ) {
+		ui_log_record* record = &log_ring[log_tail % UI_LOG_SLOTS];
+		if ( atomic_load_explicit(&record->sequence, memory_order_acquire) != log_tail + 1 )
+			break;
+
+		if ( strcmp(record->text, log_last) == 0 ) {
+			log_repeated++;
+		} else {
+			flush_repeated();
+			memcpy(log_last, record->text, sizeof(log_last));
+			jumpToLineCDKSwindow(commandOutput, BOTTOM);
+			addCDKSwindow(commandOutput, log_last, BOTTOM);
+		}
 
+		atomic_store_explicit(&record->sequence, log_tail + UI_LOG_SLOTS, memory_order_release);
+		log_tail++;
+	}
+
+	// a quiet moment, show how often the last message came
+	if ( count == 0 )
+		flush_repeated();
+
+	const unsigned int dropped = atomic_exchange_explicit(&log_dropped, 0, memory_order_relaxed);
+	if ( dropped > 0 ) {
+		char msg[64];
+		snprintf(msg, sizeof(msg), "%u messages dropped", dropped);
+		jumpToLineCDKSwindow(commandOutput, BOTTOM);
+		addCDKSwindow(commandOutput, msg, BOTTOM);
+	}
+}
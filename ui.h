@@ -19,11 +19,19 @@
 #include <signal.h>
 #include "par.h"
 
-void ui_listen_simulation (pendulum_configuration* conf, volatile sig_atomic_t* simflag);
-void ui_listen_setup (pendulum_configuration* conf, volatile sig_atomic_t* simflag, volatile sig_atomic_t* setupflag);
+/* result of the ui_listen_* functions */
+#define UI_INPUT_NONE 0		// no key pressed
+#define UI_INPUT_KEY 1		// key handled, nothing to redraw
+#define UI_INPUT_REDRAW 2	// angle, geometry or transparency changed
+#define UI_INPUT_START 3	// configuration chosen, start setup
+#define UI_INPUT_TIME 4		// time scale changed or seeked, the run left real time
+
+int ui_listen_simulation (pendulum_configuration* conf, volatile sig_atomic_t* simflag);
+int ui_listen_setup (pendulum_configuration* conf, volatile sig_atomic_t* simflag, volatile sig_atomic_t* setupflag);
 int ui_listen_config (pendulum_configuration* conf, volatile sig_atomic_t* stopflag);
 
 int ui_init ();
 void ui_terminate ();
 void ui_clear ();
-void ui_print (const char *format, ...);
+void ui_print (const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+void ui_flush (unsigned int max);
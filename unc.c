@@ -0,0 +1,150 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "unc.h"
+#include "sol.h"
+#include "ui.h"
+
+#define UNC_STEP 2.0e-3 // s, fixed runge-kutta step of the sigma points
+#define UNC_PARAMETERS 6
+#define UNC_POINTS (2 * UNC_PARAMETERS + 1)
+
+/*
+ * uncertainty of the simulated angle from the tolerances of the measured
+ * parameters (unscented transform, julier and uhlmann)
+ *
+ * for n uncertain parameters 2n + 1 sigma points (the nominal parameters
+ * and each one moved by -/+ sqrt(n) standard deviations) are integrated
+ * alongside the solver with fixed steps, the weighted mean and standard
+ * deviation of their angles give the band drawn behind the pendulum
+ * (alpha = 1, beta = 2, kappa = 0: no weight on the mean for the mean,
+ * positive weights for the variance)
+ */
+static struct {
+	unsigned int count; // sigma points, 0 if disabled
+	pendulum_configuration point[UNC_POINTS];
+	double state[UNC_POINTS][2];
+	double time;
+	double weight; // of the outer points, mean and variance
+	double weight_center; // of the nominal point, variance only
+} unc;
+
+/* parameter "i" of a configuration and its standard deviation */
+static double* parameter (pendulum_configuration* conf, unsigned int i, double* sigma) {
+	switch ( i ) {
+		case 0: *sigma = conf->uncertainty.rod_mass; return &(conf->rod.mass);
+		case 1: *sigma = conf->uncertainty.bob_radius; return &(conf->bob.radius);
+		case 2: *sigma = conf->uncertainty.friction_constant; return &(conf->bearing.friction_constant);
+		case 3: *sigma = conf->uncertainty.friction_linear; return &(conf->bearing.friction_linear);
+		case 4: *sigma = conf->uncertainty.friction_quadratic; return &(conf->bearing.friction_quadratic);
+		default: *sigma = conf->uncertainty.gravity; return &(conf->environment.gravity);
+	}
+}
+
+/* set up the sigma points at the initial condition of the run, returns their number */
+int unc_init (pendulum_configuration* conf) {
+
+	unc.count = 0;
+	if ( !conf->uncertainty.enabled )
+		return 0;
+
+	unsigned int active[UNC_PARAMETERS], n = 0, i, k;
+	double sigma;
+	for ( i = 0; i < UNC_PARAMETERS; i++ ) {
+		parameter(conf, i, &sigma);
+		if ( sigma > 0.0 )
+			active[n++] = i;
+	}
+	if ( n == 0 ) {
+		ui_print("no parameter uncertainties given...\r\n");
+		return 0;
+	}
+
+	const double spread = sqrt((double) n);
+	unc.count = 2 * n + 1;
+	unc.weight = 1.0 / (2.0 * n);
+	unc.weight_center = 2.0;
+	unc.time = conf->temp.time;
+
+	for ( k = 0; k < unc.count; k++ ) {
+		pendulum_configuration* point = &unc.point[k];
+		memcpy(point, conf, sizeof(pendulum_configuration));
+
+		// point 0 is nominal, then -/+ for each parameter
+		if ( k > 0 ) {
+			const unsigned int p = active[(k - 1) / 2];
+			double* value = parameter(point, p, &sigma);
+			*value += (k % 2 ? -1.0 : 1.0) * spread * sigma;
+			// negative friction (parameters 2 to 4) would drive the pendulum
+			if ( p >= 2 && p <= 4 && *value < 0.0 )
+				*value = 0.0;
+			par_derive_moments(point);
+		}
+
+		point->model.base.params = point;
+		point->temp.friction_direction = 0.0;
+		unc.state[k][0] = conf->temp.angle;
+		unc.state[k][1] = conf->temp.velocity;
+	}
+
+	return unc.count;
+}
+
+/* integrate the sigma points up to the solver time, returns the angle band (rad) */
+void unc_advance (pendulum_configuration* conf, double* mean, double* sigma) {
+
+	unsigned int k;
+
+	if ( unc.count == 0 ) {
+		*mean = conf->temp.angle;
+		*sigma = 0.0;
+		return;
+	}
+
+	// rewound (see sol_seek), no band until the run is back at the sigma points
+	const double span = conf->temp.time - unc.time;
+	if ( span < 0.0 ) {
+		*mean = conf->temp.angle;
+		*sigma = 0.0;
+		return;
+	}
+
+	if ( span > 0.0 ) {
+		const unsigned int steps = (unsigned int) ceil(span / UNC_STEP);
+		for ( k = 0; k < unc.count; k++ ) {
+			double time = unc.time;
+			sol_rk4_fixed(&(unc.point[k].model.base), &time, unc.state[k], span / steps, steps);
+		}
+		unc.time = conf->temp.time;
+	}
+
+	double sum = 0.0, square = 0.0;
+	for ( k = 1; k < unc.count; k++ )
+		sum += unc.weight * unc.state[k][0];
+	for ( k = 0; k < unc.count; k++ ) {
+		const double deviation = unc.state[k][0] - sum;
+		square += (k == 0 ? unc.weight_center : unc.weight) * deviation * deviation;
+	}
+
+	*mean = sum;
+	*sigma = sqrt(square);
+}
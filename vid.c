@@ -0,0 +1,256 @@
+/*
+ * pendulum_pi -- Didactic Pendulum Simulation on the Raspberry Pi
+ * Copyright (C) 2014-2017  dwh simulation services
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "vid.h"
+#include "gl.h"
+#include "sol.h"
+#include "pen.h"
+#include "ev.h"
+#include "unc.h"
+
+#define VID_BUFFERS 4 // frames in flight between rendering and encoding
+
+/*
+ * rendering (main thread) and encoding (writer thread) are connected by two
+ * bounded queues that pass a fixed pool of frame buffers back and forth:
+ * "empty" buffers go to the renderer, "full" buffers go to the encoder
+ */
+
+typedef struct {
+	unsigned char* frames[VID_BUFFERS + 1]; /* pool plus end of stream marker */
+	unsigned int head;
+	unsigned int count;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+} vid_queue;
+
+static struct {
+	vid_queue empty;
+	vid_queue full;
+	unsigned char* pool[VID_BUFFERS];
+	unsigned char* yuv;
+	unsigned int width;
+	unsigned int height;
+	FILE* file;
+	int error;
+} vid;
+
+static void queue_init (vid_queue* queue) {
+	memset(queue, 0, sizeof(vid_queue));
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->changed, NULL);
+}
+
+static void queue_destroy (vid_queue* queue) {
+	pthread_mutex_destroy(&queue->mutex);
+	pthread_cond_destroy(&queue->changed);
+}
+
+/* never blocks, the queue holds every buffer of the pool */
+static void queue_push (vid_queue* queue, unsigned char* frame) {
+	pthread_mutex_lock(&queue->mutex);
+	queue->frames[(queue->head + queue->count) % (VID_BUFFERS + 1)] = frame;
+	queue->count++;
+	pthread_cond_signal(&queue->changed);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+/* blocks until a buffer is available, NULL marks the end of the stream */
+static unsigned char* queue_pop (vid_queue* queue) {
+	pthread_mutex_lock(&queue->mutex);
+	while ( queue->count == 0 )
+		pthread_cond_wait(&queue->changed, &queue->mutex);
+	unsigned char* frame = queue->frames[queue->head];
+	queue->head = (queue->head + 1) % (VID_BUFFERS + 1);
+	queue->count--;
+	pthread_mutex_unlock(&queue->mutex);
+	return frame;
+}
+
+/* RGBA (bottom row first, as read from GL) to planar YUV 4:2:0, full range BT.601 */
+static void convert_frame (const unsigned char* rgba, unsigned char* yuv) {
+
+	const unsigned int w = vid.width;
+	const unsigned int h = vid.height;
+	unsigned char* plane_y = yuv;
+	unsigned char* plane_u = yuv + w * h;
+	unsigned char* plane_v = plane_u + (w / 2) * (h / 2);
+
+	unsigned int row, col;
+	for ( row = 0; row < h; row++ ) {
+		const unsigned char* src = rgba + (h - 1 - row) * w * 4;
+		unsigned char* dst = plane_y + row * w;
+		for ( col = 0; col < w; col++, src += 4 )
+			dst[col] = (77 * src[0] + 150 * src[1] + 29 * src[2] + 128) >> 8;
+	}
+
+	for ( row = 0; row < h / 2; row++ ) {
+		const unsigned char* src0 = rgba + (h - 1 - 2 * row) * w * 4;
+		const unsigned char* src1 = src0 - w * 4;
+		for ( col = 0; col < w / 2; col++, src0 += 8, src1 += 8 ) {
+			const int r = src0[0] + src0[4] + src1[0] + src1[4];
+			const int g = src0[1] + src0[5] + src1[1] + src1[5];
+			const int b = src0[2] + src0[6] + src1[2] + src1[6];
+			plane_u[row * (w / 2) + col] = (( -43 * r -  85 * g + 128 * b + 512) >> 10) + 128;
+			plane_v[row * (w / 2) + col] = (( 128 * r - 107 * g -  21 * b + 512) >> 10) + 128;
+		}
+	}
+}
+
+static void* encoder (void* arg) {
+
+	const size_t size = vid.width * vid.height * 3 / 2;
+	unsigned char* frame;
+
+	while ( (frame = queue_pop(&vid.full)) != NULL ) {
+		convert_frame(frame, vid.yuv);
+		queue_push(&vid.empty, frame);
+
+		if ( vid.error ) continue;
+		if ( fputs("FRAME\n", vid.file) == EOF || fwrite(vid.yuv, size, 1, vid.file) != 1 )
+			vid.error = 1;
+	}
+
+	return NULL;
+}
+
+/* render "duration" seconds of the configured simulation at "fps" into a YUV4MPEG2 file */
+int vid_export (pendulum_configuration* conf, const char* filename, double duration, unsigned int fps,
+		unsigned int width, unsigned int height) {
+
+	if ( fps == 0 || width < 2 || height < 2 || (width % 2) || (height % 2) ) {
+		fprintf(stderr, "video export needs a frame rate and an even frame size!\n\r");
+		return -1;
+	}
+
+	memset(&vid, 0, sizeof(vid));
+	vid.width = width;
+	vid.height = height;
+
+	// all buffers are allocated up front, frames only move between the queues
+
+	queue_init(&vid.empty);
+	queue_init(&vid.full);
+
+	int i, err = 0;
+	for ( i = 0; i < VID_BUFFERS; i++ ) {
+		vid.pool[i] = malloc(width * height * 4);
+		if ( vid.pool[i] == NULL ) err = -1;
+		else queue_push(&vid.empty, vid.pool[i]);
+	}
+	vid.yuv = malloc(width * height * 3 / 2);
+
+	vid.file = fopen(filename, "wb");
+	if ( vid.file == NULL ) {
+		perror("fopen");
+		err = -1;
+	}
+
+	if ( err || vid.yuv == NULL ) {
+		fprintf(stderr, "cannot prepare video export!\n\r");
+		goto cleanup;
+	}
+
+	setvbuf(vid.file, NULL, _IOFBF, 1 << 20);
+	fprintf(vid.file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+	if ( gl_init_offscreen(width, height) ) {
+		err = -1;
+		goto cleanup;
+	}
+	gl_update_geometry(0.0f, 0.0f, 0.0f, conf);
+	if ( gl_links_init(conf) || gl_band_init(conf) ) {
+		gl_terminate();
+		err = -1;
+		goto cleanup;
+	}
+	conf->temp.angle = conf->model.initial_angle;
+	conf->temp.velocity = 0.0;
+	gl_trail_reset(conf);
+
+	if ( sol_solver_init(conf) ) {
+		gl_terminate();
+		err = -1;
+		goto cleanup;
+	}
+	unc_init(conf);
+
+	pthread_t thread;
+	if ( pthread_create(&thread, NULL, encoder, NULL) ) {
+		fprintf(stderr, "cannot start encoder thread!\n\r");
+		gl_terminate();
+		sol_solver_terminate(conf);
+		err = -1;
+		goto cleanup;
+	}
+
+	// virtual time: frame n shows the state at n / fps, independent of the wall clock
+
+	const unsigned long frames = (unsigned long) (duration * fps);
+	unsigned long n;
+	for ( n = 0; n < frames && !simflag && !stopflag; n++ ) {
+
+		// abort on signals
+		ev_wait(0);
+
+		if ( n > 0 ) {
+			sol_set_time_next_frame((double) n / fps);
+			sol_solve_next_frame(conf);
+		}
+
+		double mean, sigma;
+		unc_advance(conf, &mean, &sigma);
+		gl_band_update(mean, sigma);
+
+		gl_trail_push(conf->temp.angle, conf->temp.velocity);
+		gl_links_update(conf, conf->temp.state);
+		gl_draw_frame(conf->temp.angle);
+
+		unsigned char* frame = queue_pop(&vid.empty);
+		gl_read_frame(frame);
+		queue_push(&vid.full, frame);
+	}
+
+	queue_push(&vid.full, NULL);
+	pthread_join(thread, NULL);
+
+	gl_terminate();
+	sol_solver_terminate(conf);
+
+	if ( vid.error || n < frames ) {
+		fprintf(stderr, "video export incomplete, %lu of %lu frames!\n\r", n, frames);
+		err = -1;
+	}
+
+cleanup:
+	if ( vid.file != NULL && fclose(vid.file) != 0 )
+		err = -1;
+	for ( i = 0; i < VID_BUFFERS; i++ )
+		free(vid.pool[i]);
+	free(vid.yuv);
+	queue_destroy(&vid.empty);
+	queue_destroy(&vid.full);
+
+	return err;
+}